@@ -0,0 +1,238 @@
+// bench.cpp
+// Benchmark suite, run by make bench, writing one CSV row per measurement so
+// that results can be compared across commits:
+//   scenario  end-to-end runs of tinyhost over a grid of n_hosts and
+//             n_strains, and variations in k, immunity and gamma, each for
+//             about the same number of host-steps, timed by tinyhost's own
+//             instrumentation (stats on); reports host-steps and events per
+//             second of simulation, from the time in all phases but other,
+//             which leaves out start-up (allocating and inoculating hosts)
+//   random    draws per second of each hot Randomizer method, per engine
+//   config    parses per second of each parameter file in Runs/1-Steps,
+//             including expansion of all its sweeps
+//
+// Usage: bench [-label L] [-tinyhost path] [-work host_steps] [-draws n] [-quick] [-only scenario|random|config]
+// -quick stops the grid at 1e5 hosts and does less work per measurement.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <filesystem>
+#include <unistd.h>
+#include "Config/config.h"
+#include "Randomizer/randomizer.h"
+#include "Randomizer/samplers.h"
+#include "Randomizer/urn.h"
+using namespace std;
+
+string label = "unlabelled";
+
+// Write a row: group, name and scenario settings (empty for microbenchmarks), seconds taken, then rates
+void Row(const string& group, const string& name, const string& settings, double seconds, double hosts_steps, double events, double ops)
+{
+    auto rate = [&](double n) { return n > 0 && seconds > 0 ? to_string(n / seconds) : string(); };
+    cout << label << "," << group << "," << name << "," << settings << "," << seconds << ","
+         << rate(hosts_steps) << "," << rate(events) << "," << rate(ops) << endl;
+}
+
+// Seconds taken by n calls of f, accumulating results into sink
+template <typename F>
+double Time(long long n, F f, double& sink)
+{
+    auto t0 = chrono::steady_clock::now();
+    for (long long i = 0; i < n; ++i)
+        sink += f();
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+// Repeat a value n times as a comma-separated list
+string Repeat(double x, int n)
+{
+    ostringstream out;
+    for (int i = 0; i < n; ++i)
+        out << (i ? "," : "") << x;
+    return out.str();
+}
+
+// Run tinyhost for one scenario, and return its row of stats as named values
+map<string, double> RunScenario(const string& tinyhost, const string& args, const string& dir)
+{
+    string stats = dir + "/bench.stats.txt";
+    string command = tinyhost + " " + args + " -stats on -echo 0 -fileout " + dir + "/bench.txt -filestats " + stats + " > /dev/null";
+    if (system(command.c_str()) != 0)
+        throw runtime_error("Scenario failed: " + command);
+
+    ifstream in(stats);
+    string header, line, name, value;
+    getline(in, header);
+    getline(in, line);
+    istringstream names(header), values(line);
+    map<string, double> row;
+    while (getline(names, name, '\t') && getline(values, value, '\t'))
+        row[name] = stod(value);
+    if (row.empty())
+        throw runtime_error("Could not read " + stats);
+    return row;
+}
+
+void Scenarios(const string& tinyhost, double work, bool quick)
+{
+    string dir = (filesystem::temp_directory_path() / ("tinyhost_bench_" + to_string(getpid()))).string();
+    filesystem::create_directories(dir);
+
+    struct Scenario { double n_hosts; int n_strains; double k; bool immunity; double gamma; };
+    vector<Scenario> scenarios;
+    for (double n_hosts : { 1e4, 1e5, 1e6, 1e7 })
+        for (int n_strains : { 2, 4, 10, 20 })
+            if (!quick || n_hosts <= 1e5)
+                scenarios.push_back({ n_hosts, n_strains, 1, false, 0 });
+    for (int n_strains : { 2, 20 })
+    {
+        scenarios.push_back({ 1e5, n_strains, 0.5, false, 0 });
+        scenarios.push_back({ 1e5, n_strains, 1, true, 0 });
+        scenarios.push_back({ 1e5, n_strains, 1, false, 0.5 });
+    }
+
+    for (auto& s : scenarios)
+    {
+        const double t_step = 0.001;
+        int steps = max(10, int(work / s.n_hosts));
+        ostringstream args, settings;
+        args << "-n_hosts " << (long long)s.n_hosts << " -n_strains " << s.n_strains << " -k " << s.k
+             << " -immunity " << (s.immunity ? "true" : "false") << " -gamma " << s.gamma
+             << " -w " << Repeat(1, s.n_strains) << " -beta " << Repeat(4, s.n_strains) << " -theta " << Repeat(1, s.n_strains)
+             << " -u " << Repeat(1, s.n_strains / 2) << " -t_step " << t_step << " -t_max " << (steps - 0.5) * t_step
+             << " -report " << steps;
+        settings << "n_hosts=" << (long long)s.n_hosts << " n_strains=" << s.n_strains << " k=" << s.k
+                 << " immunity=" << s.immunity << " gamma=" << s.gamma << " steps=" << steps;
+
+        auto row = RunScenario(tinyhost, args.str(), dir);
+        double seconds = 0, events = 0;
+        for (auto& nv : row)    // Total time over all phases but other, which holds start-up
+            if (nv.first != "other_s" && nv.first.size() > 2 && nv.first.compare(nv.first.size() - 2, 2, "_s") == 0)
+                seconds += nv.second;
+        for (auto kind : { "transmission", "clearance", "treatment", "birth", "transfer" })
+            events += row[kind];
+        Row("scenario", "step", settings.str(), seconds, s.n_hosts * steps, events, 0);
+    }
+    filesystem::remove_all(dir);
+}
+
+void Random(long long n)
+{
+    double sink = 0;
+    for (auto& name : Engine::Names())
+    {
+        Randomizer R;
+        R.SetEngine(name);
+        uint64_t cutoff = R.Cutoff(0.3);
+        R.SetEventRate(0, 0.3);
+        PoissonSampler poisson;
+        BinomialSampler binomial;
+        Urn urn;
+        vector<double> cumulative = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+
+        auto time = [&](const string& method, long long m, auto f) { Row("random", name + " " + method, "", Time(m, f, sink), 0, 0, m); };
+        time("Bits", n, [&]() { return R.Bits(); });
+        time("Unit", n, [&]() { return R.Unit(); });
+        time("Uniform", n, [&]() { return R.Uniform(); });
+        time("Bounded", n, [&]() { return R.Bounded(100000u); });
+        time("Discrete", n, [&]() { return R.Discrete(100000u); });
+        time("Discrete(weights)", n / 10, [&]() { return R.Discrete(cumulative); });
+        time("Trial", n, [&]() { return R.Trial(cutoff); });
+        time("Event", n, [&]() { return R.Event(0); });
+        time("Bernoulli", n, [&]() { return R.Bernoulli(0.3); });
+        time("Exponential", n / 10, [&]() { return R.Exponential(2.0); });
+        time("Poisson", n / 10, [&]() { return R.Poisson(50.0); });
+        time("PoissonSampler", n / 10, [&]() { return poisson(R, 50.0); });
+        time("Binomial", n / 10, [&]() { return R.Binomial(1000, 0.3); });
+        time("BinomialSampler", n / 10, [&]() { return binomial(R, 1000, 0.3); });
+        time("Urn::Draw", n / 10, [&]()
+        {
+            if (urn.Size() == 0)
+            {
+                urn.Clear(25);
+                for (int c = 0; c < 25; ++c)
+                    urn.Add(c, 1000);
+            }
+            return urn.Draw(R);
+        });
+    }
+    cerr << sink << "\n";   // Keep the draws from being optimized away
+}
+
+void Configs(int repeats)
+{
+    vector<filesystem::path> files;
+    for (auto& entry : filesystem::directory_iterator("Runs/1-Steps"))
+        if (entry.path().extension() == ".cfg")
+            files.push_back(entry.path());
+    sort(files.begin(), files.end());
+
+    for (auto& file : files)
+    {
+        long long sweeps = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r)
+        {
+            Parameters P;
+            P.Read(file.string());
+            for (; P.Good(); P.NextSweep())
+                ++sweeps;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        Row("config", file.filename().string(), "sweeps=" + to_string(sweeps / repeats), seconds, 0, 0, repeats);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    string tinyhost = "./tinyhost", only;
+    double work = 1e8;
+    long long draws = 20000000;
+    bool quick = false;
+    for (int a = 1; a < argc; ++a)
+    {
+        string arg = argv[a];
+        if (arg == "-quick")
+            quick = true;
+        else if (a + 1 < argc && arg == "-label")       label = argv[++a];
+        else if (a + 1 < argc && arg == "-tinyhost")    tinyhost = argv[++a];
+        else if (a + 1 < argc && arg == "-work")        work = stod(argv[++a]);
+        else if (a + 1 < argc && arg == "-draws")       draws = stoll(argv[++a]);
+        else if (a + 1 < argc && arg == "-only")        only = argv[++a];
+        else
+        {
+            cerr << "Usage: bench [-label L] [-tinyhost path] [-work host_steps] [-draws n] [-quick] [-only scenario|random|config]\n";
+            return 1;
+        }
+    }
+    if (quick)
+        work /= 10, draws /= 10;
+
+    try
+    {
+        cout << "label,group,name,settings,seconds,hosts_steps_per_s,events_per_s,ops_per_s" << endl;
+        if (only.empty() || only == "random")
+            Random(draws);
+        if (only.empty() || only == "config")
+            Configs(quick ? 20 : 200);
+        if (only.empty() || only == "scenario")
+            Scenarios(tinyhost, work, quick);
+    }
+    catch (exception& e)
+    {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+// ensemble.h
+// Online summary statistics across replicate runs. OnlineStats keeps the
+// mean and variance of a stream of values (Welford's algorithm) and
+// estimates of chosen quantiles by the P-square algorithm (R. Jain and
+// I. Chlamtac, "The P2 algorithm for dynamic calculation of quantiles and
+// histograms without storing observations", Commun. ACM 28, 1985), which
+// keeps five markers per quantile; quantiles are exact while fewer than
+// five values have been seen. Ensemble keeps OnlineStats for each column
+// of each report of a run, and writes them out as one row per report.
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// P2Quantile: P-square estimate of quantile p
+class P2Quantile
+{
+public:
+    P2Quantile(double p) : p(p), n(0) { }
+
+    void Add(double x)
+    {
+        if (n < 5)
+        {
+            q[n++] = x;
+            std::sort(q, q + n);
+            if (n == 5)
+                for (int i = 0; i < 5; ++i)
+                {
+                    pos[i] = i;
+                    want[i] = 4 * Increment(i);
+                }
+            return;
+        }
+
+        int k;      // Cell containing x, extending the extreme markers if needed
+        if (x < q[0])           { q[0] = x; k = 0; }
+        else if (x >= q[4])     { q[4] = x; k = 3; }
+        else for (k = 0; x >= q[k + 1]; ++k) ;
+
+        for (int i = k + 1; i < 5; ++i)
+            ++pos[i];
+        for (int i = 0; i < 5; ++i)
+            want[i] += Increment(i);
+        ++n;
+
+        for (int i = 1; i < 4; ++i)     // Adjust the middle markers with piecewise-parabolic interpolation
+        {
+            double d = want[i] - pos[i];
+            if ((d >= 1 && pos[i + 1] - pos[i] > 1) || (d <= -1 && pos[i - 1] - pos[i] < -1))
+            {
+                int s = d > 0 ? 1 : -1;
+                double qp = q[i] + s / (pos[i + 1] - pos[i - 1]) * ((pos[i] - pos[i - 1] + s) * (q[i + 1] - q[i]) / (pos[i + 1] - pos[i])
+                    + (pos[i + 1] - pos[i] - s) * (q[i] - q[i - 1]) / (pos[i] - pos[i - 1]));
+                if (q[i - 1] < qp && qp < q[i + 1])
+                    q[i] = qp;
+                else
+                    q[i] += s * (q[i + s] - q[i]) / (pos[i + s] - pos[i]);
+                pos[i] += s;
+            }
+        }
+    }
+
+    // Current estimate; with fewer than five values, the exact quantile with linear interpolation
+    double Get() const
+    {
+        if (n == 0)
+            return std::numeric_limits<double>::quiet_NaN();
+        if (n < 5)
+        {
+            double h = p * (n - 1);
+            int i = std::min(int(h), n - 1), j = std::min(i + 1, n - 1);
+            return q[i] + (h - i) * (q[j] - q[i]);
+        }
+        return q[2];
+    }
+
+private:
+    double Increment(int i) const   { return i == 0 ? 0 : i == 1 ? p / 2 : i == 2 ? p : i == 3 ? (1 + p) / 2 : 1; }
+
+    double p;
+    int n;
+    double q[5], pos[5], want[5];
+};
+
+// OnlineStats: mean, variance and quantiles of a stream of values
+class OnlineStats
+{
+public:
+    OnlineStats(const std::vector<double>& quantiles) : n(0), mean(0), m2(0)
+    {
+        for (auto p : quantiles)
+            q.emplace_back(p);
+    }
+
+    void Add(double x)
+    {
+        double d = x - mean;
+        mean += d / ++n;
+        m2 += d * (x - mean);
+        for (auto& qq : q)
+            qq.Add(x);
+    }
+
+    long long N() const             { return n; }
+    double Mean() const             { return n > 0 ? mean : std::numeric_limits<double>::quiet_NaN(); }
+    double Variance() const         { return n > 1 ? m2 / (n - 1) : std::numeric_limits<double>::quiet_NaN(); }
+    double Quantile(int i) const    { return q[i].Get(); }
+
+private:
+    long long n;
+    double mean, m2;
+    std::vector<P2Quantile> q;
+};
+
+// Ensemble: OnlineStats for each column of each report, over replicate runs
+class Ensemble
+{
+public:
+    Ensemble(const std::vector<std::string>& columns, const std::vector<double>& quantiles)
+     : columns(columns), quantiles(quantiles) { }
+
+    // Add one replicate, given as one row per report of the report time followed by one value per column
+    void Add(const std::vector<std::vector<double>>& rows)
+    {
+        for (size_t r = 0; r < rows.size(); ++r)
+        {
+            if (r == stats.size())
+            {
+                times.push_back(rows[r][0]);
+                stats.emplace_back(columns.size(), OnlineStats(quantiles));
+            }
+            for (size_t c = 0; c < columns.size(); ++c)
+                stats[r][c].Add(rows[r][c + 1]);
+        }
+    }
+
+    void WriteHeader(std::ostream& out) const
+    {
+        out << "run\ttau\tt\tn";
+        for (auto& c : columns)
+        {
+            out << "\t" << c << "_mean\t" << c << "_var";
+            for (auto p : quantiles)
+                out << "\t" << c << "_q" << p;
+        }
+        out << "\n";
+    }
+
+    // Write one row per report for the given run
+    void Write(std::ostream& out, int run, double tau) const
+    {
+        for (size_t r = 0; r < stats.size(); ++r)
+        {
+            out << run << "\t" << tau << "\t" << times[r] << "\t" << stats[r][0].N();
+            for (auto& s : stats[r])
+            {
+                out << "\t" << s.Mean() << "\t" << s.Variance();
+                for (size_t i = 0; i < quantiles.size(); ++i)
+                    out << "\t" << s.Quantile(i);
+            }
+            out << "\n";
+        }
+    }
+
+private:
+    std::vector<std::string> columns;
+    std::vector<double> quantiles;
+    std::vector<double> times;
+    std::vector<std::vector<OnlineStats>> stats;
+};
+
+#endif
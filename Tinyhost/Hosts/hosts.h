@@ -0,0 +1,377 @@
+// hosts.h
+// Stores for the state of every host in the population. For each strain,
+// a host has a carriage value: positive values are the proportion of the
+// host's carriage made up by that strain (summing to 1 within the host),
+// zero means the strain is absent, and negative values mean the host is
+// immune to that strain.
+//
+// DenseHosts keeps a full row of n_strains values per host; SparseHosts
+// keeps only each host's nonzero values, as a list sorted by strain,
+// which is far smaller and faster to scan when there are many strains
+// but each host carries only a few of them.
+//
+// Both stores give access to a host through a lightweight Host handle
+// with the same interface, so that the simulation engine can be written
+// once for either store.
+//
+// DenseHosts can hold carriage values at reduced precision, as float or
+// as Fixed (see below), to halve the memory traffic of sweeps over the
+// carriage matrix. Values are stored in the reduced format throughout;
+// each read widens one value to double and each write rounds one value
+// back, so arithmetic is done in double and rounded once per write.
+// Compared with double storage, each write adds an error of at most:
+//   float: 2^-24 (6.0e-8) relative to the value written;
+//   Fixed: 2^-31 (4.7e-10) absolute, i.e. relative to total host carriage.
+// Carriage is renormalized on every time step, so these errors do not
+// compound into a drift in total carriage; they perturb the ratios between
+// strains by at most one such error per write, or about sqrt(n) times it
+// after n writes in the typical case of rounding errors of random sign.
+// For the default min_carriage of 3e-5 and iota of 1e-3, even after 10^6
+// steps this is several orders of magnitude below any threshold the model
+// acts on. Immunity values are negative in both formats.
+
+#ifndef HOSTS_H
+#define HOSTS_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <istream>
+#include <ostream>
+#include "Kernels/kernels.h"
+#include "Hosts/mapped.h"
+
+// Fixed: fixed-point carriage value, a signed 32-bit integer in units of
+// 2^-30, representing values in [-2, 2); the sign bit flags immunity.
+// (A 16-bit format would have a resolution of about 3e-5 over the same
+// range, no finer than the default min_carriage, so is not offered.)
+struct Fixed
+{
+    int32_t v;
+};
+
+// Carriage<T>: conversion between stored values of type T and double.
+template <typename T>
+struct Carriage
+{
+    static bool Carried(T x)                { return x > 0; }
+    static double Load(T x)                 { return x; }
+    static T Store(double x)                { return T(x); }
+};
+
+template <>
+struct Carriage<Fixed>
+{
+    static bool Carried(Fixed x)            { return x.v > 0; }
+    static double Load(Fixed x)             { return x.v * (1.0 / (1 << 30)); }
+    static Fixed Store(double x)            { return Fixed { (int32_t)std::lrint(std::max(-2.0, std::min(x, 2.0 - 1.0 / (1 << 30))) * (1 << 30)) }; }
+};
+
+// DenseHosts: carriage matrix with one row of n_strains values of type T per host.
+// NS > 0 fixes the number of strains at compile time.
+template <int NS, typename T = double>
+class DenseHosts
+{
+public:
+    static const int Strains = NS;
+    typedef Carriage<T> C;
+
+    class Host
+    {
+    public:
+        Host(T* x, int n, const Kernels* k) : x(x), n(NS ? NS : n), k(k) { }
+
+        double Get(int s) const             { return C::Load(x[s]); }
+        void Set(int s, double v)           { x[s] = C::Store(v); }
+        bool Colonised() const              { return std::any_of(x, x + n, [](T y) { return C::Carried(y); }); }
+        void Reset()                        { std::fill(x, x + n, C::Store(0)); }
+
+        void Normalize()
+        {
+            if constexpr (std::is_same<T, double>::value)
+                return k->normalize(x, n);
+
+            double total = 0;
+            for (int s = 0; s < n; ++s)
+                if (Get(s) > 0)
+                    total += Get(s);
+            if (total > 0)
+                for (int s = 0; s < n; ++s)
+                    if (Get(s) > 0)
+                        Set(s, Get(s) / total);
+        }
+
+        // Count strains s < n_first that are carried
+        int Carried(int n_first) const      { return std::count_if(x, x + n_first, [](T y) { return C::Carried(y); }); }
+
+        // Eliminate all carried strains s = first, first + step, ..., returning true if any were carried
+        bool Clear(int first = 0, int step = 1)
+        {
+            bool cleared = false;
+            for (int s = first; s < n; s += step)
+                if (Get(s) > 0)
+                    { Set(s, 0); cleared = true; }
+            return cleared;
+        }
+
+        // Call f(s, donor value) for each strain that a transfer from donor could change: here, every strain
+        template <typename F>
+        void ForEachTransfer(const Host& donor, F f)
+        {
+            for (int s = 0; s < n; ++s)
+                f(s, donor.Get(s));
+        }
+
+        // Call f(s, value) for each carried strain
+        template <typename F>
+        void ForEachCarried(F f) const
+        {
+            for (int s = 0; s < n; ++s)
+                if (C::Carried(x[s]))
+                    f(s, Get(s));
+        }
+
+        // Replace the value of each carried strain with f(s, value)
+        template <typename F>
+        void Update(F f)
+        {
+            for (int s = 0; s < n; ++s)
+                if (C::Carried(x[s]))
+                    Set(s, f(s, Get(s)));
+        }
+
+    private:
+        T* x;
+        int n;
+        const Kernels* k;
+    };
+
+    // With a filename, the carriage matrix is kept in that memory-mapped state file, reusing its contents if warm
+    DenseHosts(long long n_hosts, int n_strains, Kernels kernels, const std::string& filename = "", bool warm = false)
+     : n(NS ? NS : n_strains), X(n_hosts * n, C::Store(0), filename, warm, n, std::is_same<T, float>::value ? 1 : std::is_same<T, Fixed>::value ? 2 : 0),
+       k(kernels) { }
+
+    Host operator[](long long i)            { return Host(X.data() + i * n, n, &k); }
+
+    // Write or read the carriage matrix in binary, for checkpoints
+    void Save(std::ostream& out) const      { out.write(reinterpret_cast<const char*>(X.data()), X.size() * sizeof(T)); }
+    void Load(std::istream& in)             { in.read(reinterpret_cast<char*>(X.data()), X.size() * sizeof(T)); }
+
+    // Access hints for a mapped carriage matrix, before a pass over all hosts or before accesses to random hosts
+    void Sequential()                       { X.Sequential(); }
+    void Random()                           { X.Random(); }
+
+    // Enforce minimum carriage, grow strains and normalize carriage of hosts h0 to h1 - 1, adding carriage to l
+    void Grow(long long h0, long long h1, const double* ww, double min_carriage, double* l)
+    {
+        if constexpr (std::is_same<T, double>::value)
+            return k.grow(this->X.data(), h0, h1, n, ww, min_carriage, l);
+
+        const int n = NS ? NS : this->n;
+        T* X = this->X.data();
+
+        for (long long i = h0 * n; i < h1 * n; i += n)
+        {
+            double total = 0;   // Tally host carriage after enforcing minimum carriage and growing strains
+            for (int s = 0; s < n; ++s)
+                if (C::Carried(X[i + s]))
+                {
+                    double x = C::Load(X[i + s]);
+                    if (x >= min_carriage)
+                        total += x * ww[s];
+                }
+
+            double inv = total > 0 ? 1 / total : 0;    // With nothing left after growth, clear every strain
+            for (int s = 0; s < n; ++s) // Apply growth, enforce host carrying capacity, and tally population carriage
+                if (C::Carried(X[i + s]))
+                {
+                    double x = C::Load(X[i + s]);
+                    x = x < min_carriage ? 0 : x * ww[s] * inv;
+                    X[i + s] = C::Store(x);
+                    l[s] += x;
+                }
+        }
+    }
+
+private:
+    int n;
+    HostStorage<T> X;
+    Kernels k;
+};
+
+// SparseHosts: a list of (strain, value) entries for each host, holding
+// only nonzero values, sorted by strain.
+class SparseHosts
+{
+public:
+    static const int Strains = 0;
+
+    struct Entry
+    {
+        int s;
+        double x;
+    };
+    typedef std::vector<Entry> Entries;
+
+    class Host
+    {
+    public:
+        Host(Entries* e) : e(e) { }
+
+        double Get(int s) const
+        {
+            for (auto& y : *e)
+                if (y.s >= s)
+                    return y.s == s ? y.x : 0;
+            return 0;
+        }
+
+        void Set(int s, double v)
+        {
+            auto y = std::lower_bound(e->begin(), e->end(), s, [](const Entry& a, int s) { return a.s < s; });
+            if (y != e->end() && y->s == s)
+            {
+                if (v != 0) y->x = v;
+                else e->erase(y);
+            }
+            else if (v != 0)
+                e->insert(y, Entry { s, v });
+        }
+
+        bool Colonised() const              { return std::any_of(e->begin(), e->end(), [](const Entry& y) { return y.x > 0; }); }
+        void Reset()                        { e->clear(); }
+
+        void Normalize()
+        {
+            double total = 0;
+            for (auto& y : *e)
+                if (y.x > 0)
+                    total += y.x;
+            if (total > 0)
+                for (auto& y : *e)
+                    if (y.x > 0)
+                        y.x /= total;
+        }
+
+        int Carried(int n_first) const
+        {
+            int m = 0;
+            for (auto& y : *e)
+                m += y.s < n_first && y.x > 0;
+            return m;
+        }
+
+        bool Clear(int first = 0, int step = 1)
+        {
+            auto end = std::remove_if(e->begin(), e->end(), [=](const Entry& y) { return y.x > 0 && y.s >= first && (y.s - first) % step == 0; });
+            bool cleared = end != e->end();
+            e->erase(end, e->end());
+            return cleared;
+        }
+
+        // Call f(s, donor value) for each strain that a transfer from donor could change: those
+        // where the donor has a nonzero value, or where this host is immune. For other strains,
+        // transfer would leave the host unchanged.
+        template <typename F>
+        void ForEachTransfer(const Host& donor, F f)
+        {
+            thread_local std::vector<Entry> candidates;
+            candidates.clear();
+            auto d = donor.e->begin(), r = e->begin();
+            while (d != donor.e->end() || r != e->end())
+            {
+                if (r == e->end() || (d != donor.e->end() && d->s <= r->s))
+                {
+                    if (r != e->end() && r->s == d->s) ++r;
+                    candidates.push_back(*d++);
+                }
+                else
+                {
+                    if (r->x < 0) candidates.push_back(Entry { r->s, 0.0 });
+                    ++r;
+                }
+            }
+            for (auto& c : candidates)
+                f(c.s, c.x);
+        }
+
+        template <typename F>
+        void ForEachCarried(F f) const
+        {
+            for (auto& y : *e)
+                if (y.x > 0)
+                    f(y.s, y.x);
+        }
+
+        template <typename F>
+        void Update(F f)
+        {
+            for (auto& y : *e)
+                if (y.x > 0)
+                    y.x = f(y.s, y.x);
+            e->erase(std::remove_if(e->begin(), e->end(), [](const Entry& y) { return y.x == 0; }), e->end());
+        }
+
+    private:
+        Entries* e;
+    };
+
+    SparseHosts(long long n_hosts, int n_strains, Kernels kernels, const std::string& filename = "", bool warm = false)
+     : H(n_hosts)
+    {
+        (void)n_strains; (void)kernels; (void)warm;
+        if (!filename.empty())
+            throw std::runtime_error("A state file needs the dense store");
+    }
+
+    Host operator[](long long i)            { return Host(&H[i]); }
+
+    void Sequential()                       { }
+    void Random()                           { }
+
+    // Write or read all entries in binary, for checkpoints
+    void Save(std::ostream& out) const
+    {
+        for (auto& e : H)
+        {
+            uint32_t size = e.size();
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(reinterpret_cast<const char*>(e.data()), size * sizeof(Entry));
+        }
+    }
+    void Load(std::istream& in)
+    {
+        for (auto& e : H)
+        {
+            uint32_t size = 0;
+            in.read(reinterpret_cast<char*>(&size), sizeof(size));
+            e.resize(size);
+            in.read(reinterpret_cast<char*>(e.data()), size * sizeof(Entry));
+        }
+    }
+
+    void Grow(long long h0, long long h1, const double* ww, double min_carriage, double* l)
+    {
+        for (long long i = h0; i < h1; ++i)
+        {
+            Entries& e = H[i];
+            double total = 0;   // Enforce host minimum carriage, grow strains, and tally host carriage
+            for (auto& y : e)
+                if (y.x > 0)
+                    total += y.x = (y.x < min_carriage ? 0 : y.x * ww[y.s]);
+            e.erase(std::remove_if(e.begin(), e.end(), [](const Entry& y) { return y.x == 0; }), e.end());
+
+            if (total > 0)      // Enforce host carrying capacity and tally population carriage
+                for (auto& y : e)
+                    if (y.x > 0)
+                        l[y.s] += y.x /= total;
+        }
+    }
+
+private:
+    std::vector<Entries> H;
+};
+
+#endif
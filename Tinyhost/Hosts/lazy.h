@@ -0,0 +1,212 @@
+// lazy.h
+// Lazy within-host growth. Between events, the carriage of strain s in a
+// host grows as x_s * w_s^t and is renormalized within the host, so rather
+// than growing every host on every time step, LazyGrowth keeps the time at
+// which each host was last brought up to date and applies growth in closed
+// form when the host is next touched.
+//
+// Strains below min_carriage are still eliminated only on the grid of time
+// steps, as in the time-step engine. The proportion of strain s in a host
+// cannot fall faster than (w_s / w_max)^t, where w_max is the largest w
+// among the strains the host carries, so after each change to a host the
+// first grid point at which any of its strains could fall below
+// min_carriage is scheduled as a check, and the host is visited then.
+//
+// Population carriage L (total carriage of each strain over all hosts) is
+// kept up to date incrementally: a host's carriage is removed from L when
+// the host is touched and added back when it is released. In between, L
+// holds each host's carriage as of its last update, so when growth rates
+// differ between strains L drifts from the exact totals; Sync brings every
+// host up to date and recomputes L exactly.
+
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include "Parallel/parallel.h"
+
+template <typename Hosts>
+class LazyGrowth
+{
+public:
+    typedef typename Hosts::Host Host;
+    static constexpr double Never = std::numeric_limits<double>::infinity();
+
+    // Hosts in X start at time t0; h is the time step, on whose grid min_carriage is enforced
+    LazyGrowth(Hosts& X, long long n_hosts, int n_strains, const std::vector<double>& w, double h, double min_carriage, double t0)
+     : L(n_strains, 0.0), X(X), n_hosts(n_hosts), n_strains(n_strains), lw(n_strains), h(h), min_carriage(min_carriage),
+       neutral(true), last(n_hosts, t0), next(n_hosts, Never)
+    {
+        for (int s = 0; s < n_strains; ++s)
+        {
+            lw[s] = std::log(w[s]);
+            neutral = neutral && lw[s] == lw[0];
+        }
+    }
+
+    // Bring host i up to time t and remove its carriage from L, before changing the host. If inclusive, strains
+    // below min_carriage are eliminated if t itself is a grid point.
+    void Touch(long long i, double t, bool inclusive = false)
+    {
+        Host x = X[i];
+        x.ForEachCarried([&](int s, double v) { L[s] -= v; });
+        if (last[i] != t || inclusive)
+        {
+            Advance(x, last[i], t, inclusive);
+            last[i] = t;
+        }
+    }
+
+    // Return the carriage of host i to L and schedule its next min_carriage check, after changing the host. If checked,
+    // the host has already been checked at time t.
+    void Release(long long i, double t, bool checked = false)
+    {
+        Host x = X[i];
+        x.ForEachCarried([&](int s, double v) { L[s] += v; });
+        next[i] = CheckTime(x, t, checked);
+        if (next[i] != Never)
+            checks.push(Check(next[i], i));
+    }
+
+    // Carry out checks scheduled before time t, or at time t if inclusive
+    void Due(double t, bool inclusive = false)
+    {
+        while (!checks.empty() && checks.top().first < t + (inclusive ? Eps : -Eps) * h)
+        {
+            Check c = checks.top();
+            checks.pop();
+            if (next[c.second] != c.first)      // Host has been touched since this check was scheduled
+                continue;
+            Touch(c.second, t, inclusive);
+            Release(c.second, t, inclusive);
+        }
+    }
+
+    // Time of the next scheduled check, or Never
+    double NextCheck()
+    {
+        while (!checks.empty() && next[checks.top().second] != checks.top().first)
+            checks.pop();
+        return checks.empty() ? Never : checks.top().first;
+    }
+
+    // Bring every host up to time t, recompute L exactly, and reschedule all checks, calling visit(th, i) from thread
+    // th for each host i once it is up to date
+    void Sync(double t, ThreadPool& pool)
+    {
+        Sync(t, pool, [](int, long long) { });
+    }
+
+    template <typename Visit>
+    void Sync(double t, ThreadPool& pool, Visit visit)
+    {
+        Lt.assign(pool.Size(), std::vector<double>(n_strains, 0.0));
+        pool.For(0, n_hosts, [&](int th, long long h0, long long h1)
+        {
+            for (long long i = h0; i < h1; ++i)
+            {
+                Host x = X[i];
+                if (last[i] != t)
+                {
+                    Advance(x, last[i], t);
+                    last[i] = t;
+                }
+                x.ForEachCarried([&](int s, double v) { Lt[th][s] += v; });
+                next[i] = CheckTime(x, t);
+                visit(th, i);
+            }
+        });
+        for (int s = 0; s < n_strains; ++s)     // Reduce per-thread carriage in thread order
+        {
+            L[s] = 0;
+            for (auto& ll : Lt)
+                L[s] += ll[s];
+        }
+
+        std::vector<Check> c;
+        for (long long i = 0; i < n_hosts; ++i)
+            if (next[i] != Never)
+                c.push_back(Check(next[i], i));
+        checks = Checks(std::greater<Check>(), std::move(c));
+    }
+
+    std::vector<double> L;                      // Population carriage
+
+private:
+    typedef std::pair<double, long long> Check; // Time of check, host
+    typedef std::priority_queue<Check, std::vector<Check>, std::greater<Check>> Checks;
+    static constexpr double Eps = 1e-6;         // Tolerance for times on the grid, in time steps
+
+    // Grow strains in host x over a time dt with no elimination
+    void Grow(Host& x, double dt)
+    {
+        if (neutral || dt <= 0)
+            return;
+        x.Update([&](int s, double v) { return v * std::exp(lw[s] * dt); });
+        x.Normalize();
+    }
+
+    // Time from now until any strain in host x could first fall below min_carriage, or Never
+    double Safe(const Host& x) const
+    {
+        double lmax = -Never, safe = Never;
+        x.ForEachCarried([&](int s, double) { lmax = std::max(lmax, lw[s]); });
+        x.ForEachCarried([&](int s, double v)
+        {
+            if (v < min_carriage)
+                safe = 0;
+            else if (lw[s] < lmax)
+                safe = std::min(safe, std::log(min_carriage / v) / (lw[s] - lmax));
+        });
+        return safe;
+    }
+
+    // First grid point, at or after time t (or after t, if checked), at which host x needs to be checked for elimination
+    double CheckTime(const Host& x, double t, bool checked = false) const
+    {
+        double safe = Safe(x);
+        if (safe == Never)
+            return Never;
+        double k = std::ceil((t + safe) / h - Eps);
+        return (checked ? std::max(k, std::floor(t / h + Eps) + 1) : k) * h;
+    }
+
+    // Bring host x from time t0 to t1, eliminating strains below min_carriage at grid points in [t0, t1), or [t0, t1]
+    // if inclusive
+    void Advance(Host& x, double t0, double t1, bool inclusive = false)
+    {
+        double t = t0;
+        for (double k = std::ceil(t0 / h - Eps); k * h < t1 + (inclusive ? Eps : -Eps) * h; )
+        {
+            Grow(x, k * h - t);
+            t = k * h;
+
+            bool cut = false;
+            x.Update([&](int, double v) { if (v < min_carriage) { cut = true; return 0.0; } return v; });
+            if (cut)
+                x.Normalize();
+
+            double safe = Safe(x);      // Skip grid points at which no strain can fall below min_carriage
+            if (safe == Never)
+                break;
+            k += std::floor(safe / h) + 1;
+        }
+        Grow(x, t1 - t);
+    }
+
+    Hosts& X;
+    long long n_hosts;
+    int n_strains;
+    std::vector<double> lw;                     // log w for each strain
+    double h, min_carriage;
+    bool neutral;                               // All strains grow at the same rate
+    std::vector<double> last, next;             // For each host, time of last update and of next check
+    Checks checks;
+    std::vector<std::vector<double>> Lt;        // Per-thread population carriage accumulators
+};
+
+#endif
@@ -0,0 +1,118 @@
+// mapped.h
+// HostStorage: the array behind DenseHosts, held either in memory or in a
+// memory-mapped state file, so that populations larger than RAM can be run
+// with the operating system paging the carriage matrix in and out. The file
+// starts with a one-page header recording the shape and value type of the
+// array, followed by the values themselves; an existing file of the same
+// shape can be reopened as a warm start, keeping its contents. Access hints
+// tell the kernel how the array is about to be used: Sequential() before a
+// pass over all hosts in order (aggressive read-ahead, and pages behind the
+// pass may be dropped early) and Random() before scattered accesses to
+// single hosts (no read-ahead). Hints do nothing for arrays in memory.
+
+#ifndef MAPPED_H
+#define MAPPED_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+template <typename T>
+class HostStorage
+{
+public:
+    // n values, in rows of stride, set to fill, in memory if filename is empty; with warm, an existing file's values are
+    // kept instead. type distinguishes value types of the same size.
+    HostStorage(size_t n, T fill, const std::string& filename = "", bool warm = false, uint32_t stride = 1, uint32_t type = 0)
+     : n(n), p(0), map(0), fd(-1)
+    {
+        if (filename.empty())
+        {
+            memory.assign(n, fill);
+            p = memory.data();
+            return;
+        }
+
+        fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Could not open state file " + filename);
+
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, "THHOSTS1", 8);
+        h.n = n;
+        h.stride = stride;
+        h.value_size = sizeof(T);
+        h.type = type;
+        bytes = Page + n * sizeof(T);
+        struct stat st;
+        if (warm)
+        {
+            Header g;
+            if (fstat(fd, &st) != 0 || size_t(st.st_size) != bytes || pread(fd, &g, sizeof(g), 0) != sizeof(g) ||
+                std::memcmp(&g, &h, sizeof(h)) != 0)
+                Fail("State file " + filename + " does not match the population for a warm start");
+        }
+        else if (ftruncate(fd, 0) != 0 || ftruncate(fd, bytes) != 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h))
+            Fail("Could not size state file " + filename);
+
+        map = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            Fail("Could not map state file " + filename);
+        p = reinterpret_cast<T*>(static_cast<char*>(map) + Page);
+
+        const T zero = T();     // A fresh file reads as zero bytes, so only needs filling with anything else
+        if (!warm && std::memcmp(&fill, &zero, sizeof(T)) != 0)
+            std::fill(p, p + n, fill);
+    }
+
+    HostStorage(const HostStorage&) = delete;
+    HostStorage& operator=(const HostStorage&) = delete;
+
+    ~HostStorage()
+    {
+        if (map && map != MAP_FAILED)
+            munmap(map, bytes);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    T* data()                               { return p; }
+    const T* data() const                   { return p; }
+    size_t size() const                     { return n; }
+    T& operator[](size_t i)                 { return p[i]; }
+
+    void Sequential()                       { if (map) madvise(map, bytes, MADV_SEQUENTIAL); }
+    void Random()                           { if (map) madvise(map, bytes, MADV_RANDOM); }
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint64_t n;
+        uint32_t stride, value_size, type, reserved;
+    };
+    static const size_t Page = 4096;
+
+    void Fail(const std::string& message)
+    {
+        close(fd);
+        fd = -1;
+        throw std::runtime_error(message);
+    }
+
+    size_t n, bytes;
+    T* p;
+    std::vector<T> memory;
+    void* map;
+    int fd;
+};
+
+#endif
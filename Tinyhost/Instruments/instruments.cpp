@@ -0,0 +1,161 @@
+// instruments.cpp
+
+#include "instruments.h"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const char* PhaseNames[Instruments::Phases] = { "other", "checkpoint", "growth", "event_counts", "shuffle", "events", "report" };
+static const char* KindNames[Instruments::Kinds] = { "transmission", "clearance", "treatment", "birth", "transfer" };
+static const char* CounterNames[Instruments::Counters] = { "cycles", "cache_misses", "branch_misses" };
+static const uint64_t CounterConfigs[Instruments::Counters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+Instruments::Instruments(bool perf)
+ : perf(perf), mark(std::chrono::steady_clock::now())
+{
+    for (int c = 0; c < Counters; ++c)
+        fd[c] = -1, hw_mark[c] = 0;
+    if (!perf)
+        return;
+
+    for (int c = 0; c < Counters; ++c)     // Open the counters as one group, counting user space on this thread
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = CounterConfigs[c];
+        attr.disabled = c == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        fd[c] = syscall(__NR_perf_event_open, &attr, 0, -1, c == 0 ? -1 : fd[0], 0);
+        if (fd[c] < 0)
+        {
+            std::string error = std::strerror(errno);
+            for (int d = 0; d < c; ++d)
+                close(fd[d]);
+            throw std::runtime_error(std::string("Could not open hardware counter ") + CounterNames[c] + " (perf_event_open): " + error);
+        }
+    }
+    ioctl(fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+Instruments::~Instruments()
+{
+    for (int c = 0; c < Counters; ++c)
+        if (fd[c] >= 0)
+            close(fd[c]), fd[c] = -1;
+}
+
+void Instruments::Enter(Phase p)
+{
+    Charge();
+    stack.push_back(p);
+    ++phases[p].calls;
+}
+
+void Instruments::Leave()
+{
+    Charge();
+    stack.pop_back();
+}
+
+// Charge the time and hardware counts since the last charge to the innermost phase, or to Other
+void Instruments::Charge()
+{
+    auto now = std::chrono::steady_clock::now();
+    Counts& c = phases[stack.empty() ? Other : stack.back()];
+    c.seconds += std::chrono::duration<double>(now - mark).count();
+    mark = now;
+    if (perf)
+    {
+        uint64_t values[1 + Counters];
+        if (read(fd[0], values, sizeof(values)) == sizeof(values))
+            for (int k = 0; k < Counters; ++k)
+            {
+                c.hw[k] += values[1 + k] - hw_mark[k];
+                hw_mark[k] = values[1 + k];
+            }
+    }
+}
+
+void Instruments::Add(const Instruments& I)
+{
+    perf = perf || I.perf;
+    for (int p = 0; p < Phases; ++p)
+    {
+        phases[p].seconds += I.phases[p].seconds;
+        phases[p].calls += I.phases[p].calls;
+        for (int k = 0; k < Counters; ++k)
+            phases[p].hw[k] += I.phases[p].hw[k];
+    }
+    for (int k = 0; k < Kinds; ++k)
+        events[k] += I.events[k];
+    draws += I.draws;
+}
+
+void Instruments::WriteHeader(std::ostream& out, bool perf)
+{
+    out << "run\trep\ttau";
+    for (auto p : PhaseNames)
+    {
+        out << "\t" << p << "_s";
+        for (auto c : CounterNames)
+            if (perf)
+                out << "\t" << p << "_" << c;
+    }
+    for (auto k : KindNames)
+        out << "\t" << k;
+    out << "\tdraws\n";
+}
+
+void Instruments::Write(std::ostream& out, int run, int replicate, double tau) const
+{
+    out << run << "\t" << replicate << "\t" << tau;
+    for (auto& p : phases)
+    {
+        out << "\t" << p.seconds;
+        for (int c = 0; c < Counters && perf; ++c)
+            out << "\t" << p.hw[c];
+    }
+    for (auto k : events)
+        out << "\t" << k;
+    out << "\t" << draws << "\n";
+}
+
+void Instruments::Summary(std::ostream& out, int runs) const
+{
+    double total = 0;
+    uint64_t n_events = 0;
+    for (auto& p : phases)
+        total += p.seconds;
+    for (auto k : events)
+        n_events += k;
+
+    out << "Instrumentation over " << runs << " run" << (runs == 1 ? "" : "s") << "\n";
+    out << std::left << std::setw(14) << "phase" << std::right << std::setw(12) << "seconds" << std::setw(8) << "share" << std::setw(12) << "calls";
+    for (int c = 0; c < Counters && perf; ++c)
+        out << std::setw(16) << CounterNames[c];
+    out << "\n";
+    for (int p = 0; p < Phases; ++p)
+    {
+        out << std::left << std::setw(14) << PhaseNames[p] << std::right << std::fixed << std::setprecision(3) << std::setw(12) << phases[p].seconds
+            << std::setprecision(1) << std::setw(7) << (total > 0 ? 100 * phases[p].seconds / total : 0) << "%" << std::setw(12) << phases[p].calls;
+        for (int c = 0; c < Counters && perf; ++c)
+            out << std::setw(16) << phases[p].hw[c];
+        out << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6);
+    out << "events:";
+    for (int k = 0; k < Kinds; ++k)
+        out << " " << KindNames[k] << " " << events[k];
+    out << " (" << (total > 0 ? n_events / total : 0) << " per second)\n";
+    out << "random draws: " << draws << " (" << (n_events > 0 ? double(draws) / n_events : 0) << " per event)\n";
+}
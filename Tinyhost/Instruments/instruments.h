@@ -0,0 +1,76 @@
+// instruments.h
+// Built-in instrumentation of a run: wall-clock time spent in each phase of
+// the main loop, the number of events executed of each kind, the number of
+// 32-bit random draws (from the run's Randomizer and any per-event
+// streams), and optionally hardware counters per phase (cycles, cache
+// misses and branch misses) from perf_event_open. Phases are timed with
+// Scope objects, which do nothing if given no Instruments, so a run without
+// instrumentation pays one test per scope. A scope can switch from phase to
+// phase as it goes. Scopes nest, and time is charged to the innermost phase
+// only; time outside any scope goes to Other.
+// Hardware counters cover the thread that created the Instruments only,
+// not the workers of a thread pool.
+
+#ifndef INSTRUMENTS_H
+#define INSTRUMENTS_H
+
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <ostream>
+
+class Instruments
+{
+public:
+    enum Phase { Other, Checkpointing, Growth, EventCounts, Shuffle, Events, Reporting, Phases };
+    enum { Kinds = 5, Counters = 3 };   // Numbers of event kinds and of hardware counters
+
+    // With perf, also read hardware counters, throwing if they cannot be opened
+    Instruments(bool perf = false);
+    ~Instruments();
+    Instruments(const Instruments&) = delete;
+    Instruments& operator=(const Instruments&) = delete;
+
+    // Scope: charges the time until it is destroyed to phase p of I, or to the phase it last switched to, if I is set
+    class Scope
+    {
+    public:
+        Scope(Instruments* I, Phase p) : I(I)   { if (I) I->Enter(p); }
+        ~Scope()                                { if (I) I->Leave(); }
+        void Switch(Phase p)                    { if (I) I->Leave(), I->Enter(p); }
+    private:
+        Instruments* I;
+    };
+
+    // Count n events executed of the given kind (an event type of tinyhost.cpp shifted right by 16 bits), or n random
+    // draws
+    void Executed(int kind, uint64_t n)     { events[kind] += n; }
+    void Drawn(uint64_t n)                  { draws += n; }
+
+    // Add the counts of I to these
+    void Add(const Instruments& I);
+
+    // Write a header, and one row for the given run, of a tab-separated table of counts
+    static void WriteHeader(std::ostream& out, bool perf);
+    void Write(std::ostream& out, int run, int replicate, double tau) const;
+
+    // Write a readable summary, for totals over runs
+    void Summary(std::ostream& out, int runs) const;
+
+private:
+    struct Counts { double seconds = 0; uint64_t calls = 0, hw[Counters] = { 0 }; };
+
+    void Enter(Phase p);
+    void Leave();
+    void Charge();
+
+    bool perf;
+    int fd[Counters];                                   // Hardware counter group, leader first
+    std::vector<Phase> stack;                           // Phases entered and not yet left, innermost last
+    std::chrono::steady_clock::time_point mark;         // Time and hardware counts when last charged
+    uint64_t hw_mark[Counters];
+    Counts phases[Phases];
+    uint64_t events[Kinds] = { 0 }, draws = 0;
+};
+
+#endif
@@ -0,0 +1,236 @@
+// kernels.cpp
+// The vectorized kernels replace per-strain branches with compare masks
+// and blends, and divide by host carriage once per host by multiplying
+// with its reciprocal. Each host row is processed in whole vectors, with
+// masked loads and stores for the final partial vector, so any number
+// of strains is supported. Because they sum in a different order and
+// multiply by a reciprocal, results can differ from the scalar kernels
+// in the last bits.
+
+#include "kernels.h"
+#include <immintrin.h>
+#include <stdexcept>
+
+// SCALAR KERNELS
+
+// N > 0 fixes the number of strains at compile time, so that the compiler can unroll the loops over strains.
+template <int N>
+static void GrowScalar(double* X, long long h0, long long h1, int n, const double* ww, double min_carriage, double* l)
+{
+    if (N) n = N;
+    for (long long i = h0 * n; i < h1 * n; i += n)
+    {
+        double total = 0;   // Enforce host minimum carriage, grow strains, and tally host carriage
+        for (int s = 0; s < n; ++s)
+            if (X[i + s] > 0)
+                total += X[i + s] = (X[i + s] < min_carriage ? 0 : X[i + s] * ww[s]);
+
+        if (total > 0)      // Enforce host carrying capacity and tally population carriage
+            for (int s = 0; s < n; ++s)
+                if (X[i + s] > 0)
+                    l[s] += X[i + s] /= total;
+    }
+}
+
+template <int N>
+static void NormalizeScalar(double* x, int n)
+{
+    if (N) n = N;
+    double total = 0;
+    for (int s = 0; s < n; ++s)
+        if (x[s] > 0)
+            total += x[s];
+    if (total > 0)
+        for (int s = 0; s < n; ++s)
+            if (x[s] > 0)
+                x[s] /= total;
+}
+
+// AVX2 KERNELS
+
+__attribute__((target("avx2")))
+static inline __m256i TailMask256(int rem)  // Lanes 0 to rem - 1 set
+{
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(rem), _mm256_setr_epi64x(0, 1, 2, 3));
+}
+
+__attribute__((target("avx2")))
+static inline double HorizontalSum256(__m256d v)
+{
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+__attribute__((target("avx2")))
+static void GrowAVX2(double* X, long long h0, long long h1, int n, const double* ww, double min_carriage, double* l)
+{
+    const __m256d zero = _mm256_setzero_pd(), min = _mm256_set1_pd(min_carriage);
+    const int full = n & ~3;
+    const __m256i tail = TailMask256(n - full);
+
+    for (double* x = X + h0 * n; x < X + h1 * n; x += n)
+    {
+        // Enforce host minimum carriage, grow strains, and tally host carriage
+        __m256d total = zero;
+        for (int s = 0; s < n; s += 4)
+        {
+            __m256i m = s < full ? _mm256_set1_epi64x(-1) : tail;
+            __m256d v = _mm256_maskload_pd(x + s, m);
+            __m256d pos = _mm256_cmp_pd(v, zero, _CMP_GT_OQ);
+            if (_mm256_testz_pd(pos, pos))
+                continue;
+            __m256d g = _mm256_and_pd(_mm256_mul_pd(v, _mm256_maskload_pd(ww + s, m)), _mm256_cmp_pd(v, min, _CMP_GE_OQ));
+            _mm256_maskstore_pd(x + s, m, _mm256_blendv_pd(v, g, pos));
+            total = _mm256_add_pd(total, _mm256_and_pd(g, pos));
+        }
+
+        // Enforce host carrying capacity and tally population carriage
+        double t = HorizontalSum256(total);
+        if (t > 0)
+        {
+            __m256d inv = _mm256_set1_pd(1.0 / t);
+            for (int s = 0; s < n; s += 4)
+            {
+                __m256i m = s < full ? _mm256_set1_epi64x(-1) : tail;
+                __m256d v = _mm256_maskload_pd(x + s, m);
+                __m256d pos = _mm256_cmp_pd(v, zero, _CMP_GT_OQ);
+                __m256d y = _mm256_and_pd(_mm256_mul_pd(v, inv), pos);
+                _mm256_maskstore_pd(x + s, m, _mm256_blendv_pd(v, y, pos));
+                _mm256_maskstore_pd(l + s, m, _mm256_add_pd(_mm256_maskload_pd(l + s, m), y));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void NormalizeAVX2(double* x, int n)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const int full = n & ~3;
+    const __m256i tail = TailMask256(n - full);
+
+    __m256d total = zero;
+    for (int s = 0; s < n; s += 4)
+    {
+        __m256d v = _mm256_maskload_pd(x + s, s < full ? _mm256_set1_epi64x(-1) : tail);
+        total = _mm256_add_pd(total, _mm256_and_pd(v, _mm256_cmp_pd(v, zero, _CMP_GT_OQ)));
+    }
+
+    double t = HorizontalSum256(total);
+    if (t > 0)
+    {
+        __m256d inv = _mm256_set1_pd(1.0 / t);
+        for (int s = 0; s < n; s += 4)
+        {
+            __m256i m = s < full ? _mm256_set1_epi64x(-1) : tail;
+            __m256d v = _mm256_maskload_pd(x + s, m);
+            _mm256_maskstore_pd(x + s, m, _mm256_blendv_pd(v, _mm256_mul_pd(v, inv), _mm256_cmp_pd(v, zero, _CMP_GT_OQ)));
+        }
+    }
+}
+
+// AVX-512 KERNELS
+
+__attribute__((target("avx512f")))
+static void GrowAVX512(double* X, long long h0, long long h1, int n, const double* ww, double min_carriage, double* l)
+{
+    const __m512d zero = _mm512_setzero_pd(), min = _mm512_set1_pd(min_carriage);
+    const int full = n & ~7;
+    const __mmask8 tail = (1u << (n - full)) - 1;
+
+    for (double* x = X + h0 * n; x < X + h1 * n; x += n)
+    {
+        // Enforce host minimum carriage, grow strains, and tally host carriage
+        __m512d total = zero;
+        for (int s = 0; s < n; s += 8)
+        {
+            __mmask8 m = s < full ? 0xFF : tail;
+            __m512d v = _mm512_maskz_loadu_pd(m, x + s);
+            __mmask8 pos = _mm512_cmp_pd_mask(v, zero, _CMP_GT_OQ);
+            if (!pos)
+                continue;
+            __mmask8 keep = _mm512_cmp_pd_mask(v, min, _CMP_GE_OQ);
+            __m512d g = _mm512_maskz_mul_pd(keep, v, _mm512_maskz_loadu_pd(m, ww + s));
+            _mm512_mask_storeu_pd(x + s, m & pos, g);
+            total = _mm512_mask_add_pd(total, pos, total, g);
+        }
+
+        // Enforce host carrying capacity and tally population carriage
+        double t = _mm512_reduce_add_pd(total);
+        if (t > 0)
+        {
+            __m512d inv = _mm512_set1_pd(1.0 / t);
+            for (int s = 0; s < n; s += 8)
+            {
+                __mmask8 m = s < full ? 0xFF : tail;
+                __m512d v = _mm512_maskz_loadu_pd(m, x + s);
+                __mmask8 pos = _mm512_cmp_pd_mask(v, zero, _CMP_GT_OQ);
+                __m512d y = _mm512_maskz_mul_pd(pos, v, inv);
+                _mm512_mask_storeu_pd(x + s, pos, y);
+                _mm512_mask_storeu_pd(l + s, m, _mm512_add_pd(_mm512_maskz_loadu_pd(m, l + s), y));
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void NormalizeAVX512(double* x, int n)
+{
+    const __m512d zero = _mm512_setzero_pd();
+    const int full = n & ~7;
+    const __mmask8 tail = (1u << (n - full)) - 1;
+
+    __m512d total = zero;
+    for (int s = 0; s < n; s += 8)
+    {
+        __m512d v = _mm512_maskz_loadu_pd(s < full ? 0xFF : tail, x + s);
+        total = _mm512_mask_add_pd(total, _mm512_cmp_pd_mask(v, zero, _CMP_GT_OQ), total, v);
+    }
+
+    double t = _mm512_reduce_add_pd(total);
+    if (t > 0)
+    {
+        __m512d inv = _mm512_set1_pd(1.0 / t);
+        for (int s = 0; s < n; s += 8)
+        {
+            __m512d v = _mm512_maskz_loadu_pd(s < full ? 0xFF : tail, x + s);
+            _mm512_mask_storeu_pd(x + s, _mm512_cmp_pd_mask(v, zero, _CMP_GT_OQ), _mm512_mul_pd(v, inv));
+        }
+    }
+}
+
+// SELECTION
+
+template <int N>
+static Kernels ScalarKernels()
+{
+    return Kernels { GrowScalar<N>, NormalizeScalar<N>, "scalar" };
+}
+
+Kernels SelectKernels(std::string which, int n)
+{
+    __builtin_cpu_init();
+    bool avx512 = __builtin_cpu_supports("avx512f"), avx2 = __builtin_cpu_supports("avx2");
+
+    // Vector kernels only pay off once rows span several vectors; below that, the
+    // branches of the scalar kernels skip empty strains more cheaply than masking.
+    if (which == "auto")
+        which = n > 0 && n < 16 ? "scalar" : avx512 ? "avx512" : avx2 ? "avx2" : "scalar";
+
+    if (which == "scalar") switch (n)
+    {
+        case 2:  return ScalarKernels<2>();
+        case 4:  return ScalarKernels<4>();
+        case 10: return ScalarKernels<10>();
+        case 20: return ScalarKernels<20>();
+        case 60: return ScalarKernels<60>();
+        default: return ScalarKernels<0>();
+    }
+    if (which == "avx2" && avx2)
+        return Kernels { GrowAVX2, NormalizeAVX2, "avx2" };
+    if (which == "avx512" && avx512)
+        return Kernels { GrowAVX512, NormalizeAVX512, "avx512" };
+    if (which == "avx2" || which == "avx512")
+        throw std::runtime_error("Kernels " + which + " are not supported by this CPU.");
+    throw std::runtime_error("Unrecognized kernels " + which + ".");
+}
@@ -0,0 +1,29 @@
+// kernels.h
+// Row operations on the carriage matrix, with scalar, AVX2 and AVX-512
+// implementations. The implementation is chosen at run time according to
+// the features of the CPU, so that one binary runs on any x86-64 machine.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <string>
+
+struct Kernels
+{
+    // For hosts h0 to h1 - 1 of carriage matrix X with n strains per host: eliminate strains below
+    // min_carriage, grow strains by ww, normalize host carriage, and add normalized carriage to l.
+    void (*grow)(double* X, long long h0, long long h1, int n, const double* ww, double min_carriage, double* l);
+
+    // Normalize the n carriage values of one host so that the positive values sum to 1.
+    void (*normalize)(double* x, int n);
+
+    const char* name;
+};
+
+// Returns the kernels named by which ("scalar", "avx2" or "avx512"), or
+// the fastest kernels for n strains supported by this CPU if which is
+// "auto". If n is given, scalar kernels may be specialized for exactly n
+// strains.
+Kernels SelectKernels(std::string which, int n = 0);
+
+#endif
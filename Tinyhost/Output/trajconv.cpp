@@ -0,0 +1,44 @@
+// trajconv.cpp
+// Converts a binary trajectory file (see trajectory.h) back to the
+// tab-separated text that tinyhost writes with format text, or lists its
+// index of runs.
+//
+// Usage: trajconv file [run]     writes all runs, or one run, as text
+//        trajconv -index file    lists each run's rows and byte range
+
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include "Output/trajectory.h"
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc == 3 && string(argv[1]) == "-index")
+        {
+            TrajectoryReader reader(argv[2]);
+            cout << "run\trows\tbegin\tend\n";
+            for (auto& e : reader.Index())
+                cout << e.run << "\t" << e.rows << "\t" << e.begin << "\t" << e.end << "\n";
+        }
+        else if (argc == 2 || argc == 3)
+        {
+            TrajectoryReader reader(argv[1]);
+            reader.WriteText(cout, argc == 3 ? stoi(argv[2]) : -1);
+        }
+        else
+        {
+            cerr << "Usage: trajconv file [run]\n       trajconv -index file\n";
+            return 1;
+        }
+    }
+    catch (exception& e)
+    {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+// trajectory.cpp
+
+#include "trajectory.h"
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <zlib.h>
+
+static const char Magic[8] = { 'T', 'H', 'T', 'R', 'A', 'J', '0', '1' }, IndexMagic[8] = { 'T', 'H', 'T', 'R', 'I', 'D', 'X', '1' };
+static const uint32_t BlockMagic = 0x4b4c4254;     // "TBLK"
+static const size_t BlockHeader = 4 + 4 + 4 + 1 + 8 + 8;
+
+template <typename T> static void Put(std::ostream& out, T x)   { out.write(reinterpret_cast<const char*>(&x), sizeof(x)); }
+template <typename T> static bool Get(std::istream& in, T& x)   { return bool(in.read(reinterpret_cast<char*>(&x), sizeof(x))); }
+
+TrajectoryWriter::TrajectoryWriter(std::ostream& out, const std::vector<ColumnType>& types, int run, int compress, int block_rows)
+ : out(out), types(types), run(run), compress(compress), block_rows(block_rows), rows(0), columns(types.size())
+{
+}
+
+void TrajectoryWriter::WriteHeader(std::ostream& out, const std::vector<std::string>& names, const std::vector<ColumnType>& types)
+{
+    out.write(Magic, sizeof(Magic));
+    Put(out, uint32_t(names.size()));
+    for (size_t c = 0; c < names.size(); ++c)
+    {
+        Put(out, uint8_t(types[c]));
+        Put(out, uint16_t(names[c].size()));
+        out.write(names[c].data(), names[c].size());
+    }
+}
+
+void TrajectoryWriter::Add(const std::vector<double>& row)
+{
+    for (size_t c = 0; c < types.size(); ++c)
+    {
+        auto& col = columns[c];
+        if (types[c] == Int32)
+        {
+            int32_t v = row[c];
+            col.insert(col.end(), reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + sizeof(v));
+        }
+        else
+            col.insert(col.end(), reinterpret_cast<const char*>(&row[c]), reinterpret_cast<const char*>(&row[c]) + sizeof(double));
+    }
+    if (++rows == block_rows)
+        Flush();
+}
+
+void TrajectoryWriter::Flush()
+{
+    if (rows == 0)
+        return;
+
+    std::vector<char> raw;
+    for (auto& col : columns)
+    {
+        raw.insert(raw.end(), col.begin(), col.end());
+        col.clear();
+    }
+
+    uint8_t codec = 0;
+    std::vector<char> packed;
+    if (compress > 0)
+    {
+        uLongf size = compressBound(raw.size());
+        packed.resize(size);
+        if (compress2(reinterpret_cast<Bytef*>(packed.data()), &size, reinterpret_cast<const Bytef*>(raw.data()), raw.size(), compress) != Z_OK)
+            throw std::runtime_error("Could not compress trajectory block");
+        packed.resize(size);
+        codec = 1;
+    }
+    const std::vector<char>& stored = codec ? packed : raw;
+
+    Put(out, BlockMagic);
+    Put(out, uint32_t(run));
+    Put(out, uint32_t(rows));
+    Put(out, codec);
+    Put(out, uint64_t(raw.size()));
+    Put(out, uint64_t(stored.size()));
+    out.write(stored.data(), stored.size());
+    rows = 0;
+}
+
+void FinishTrajectory(const std::string& filename)
+{
+    if (!TrajectoryReader::IsTrajectory(filename))
+        return;
+
+    std::vector<TrajectoryReader::Entry> index;
+    uint64_t end;
+    {
+        TrajectoryReader reader(filename);
+        index = reader.Index();
+        end = index.empty() ? 0 : index.back().end;
+    }
+    if (index.empty())      // No blocks: the data ends after the header
+    {
+        std::ifstream in(filename, std::ios::binary);
+        uint32_t n_columns = 0;
+        in.seekg(sizeof(Magic));
+        Get(in, n_columns);
+        for (uint32_t c = 0; c < n_columns; ++c)
+        {
+            uint8_t type; uint16_t length = 0;
+            Get(in, type); Get(in, length);
+            in.seekg(length, std::ios::cur);
+        }
+        end = in.tellg();
+    }
+
+    std::filesystem::resize_file(filename, end);
+    std::ofstream out(filename, std::ios::binary | std::ios::app);
+    Put(out, uint64_t(index.size()));
+    for (auto& e : index)
+    {
+        Put(out, e.run);
+        Put(out, e.begin);
+        Put(out, e.end);
+        Put(out, e.rows);
+    }
+    Put(out, end);
+    out.write(IndexMagic, sizeof(IndexMagic));
+}
+
+bool TrajectoryReader::IsTrajectory(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(Magic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& filename)
+ : in(filename, std::ios::binary)
+{
+    char magic[sizeof(Magic)];
+    uint32_t n_columns = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 || !Get(in, n_columns))
+        throw std::runtime_error("Not a trajectory file: " + filename);
+    for (uint32_t c = 0; c < n_columns; ++c)
+    {
+        uint8_t type; uint16_t length = 0;
+        Get(in, type); Get(in, length);
+        std::string name(length, ' ');
+        in.read(&name[0], length);
+        types.push_back(ColumnType(type));
+        names.push_back(name);
+    }
+    if (!in)
+        throw std::runtime_error("Could not read trajectory file header: " + filename);
+    data_begin = in.tellg();
+
+    // Read the index from the footer if there is one, or build it by scanning blocks
+    in.seekg(0, std::ios::end);
+    uint64_t size = in.tellg(), footer = 0;
+    char index_magic[sizeof(IndexMagic)];
+    if (size >= data_begin + 16)
+    {
+        in.seekg(size - 16);
+        Get(in, footer);
+        in.read(index_magic, sizeof(index_magic));
+    }
+    if (size >= data_begin + 16 && std::memcmp(index_magic, IndexMagic, sizeof(IndexMagic)) == 0)
+    {
+        uint64_t n = 0;
+        in.seekg(footer);
+        Get(in, n);
+        index.resize(n);
+        for (auto& e : index)
+            { Get(in, e.run); Get(in, e.begin); Get(in, e.end); Get(in, e.rows); }
+        if (!in)
+            throw std::runtime_error("Could not read trajectory file index: " + filename);
+        return;
+    }
+
+    in.clear();
+    std::vector<char> data;
+    uint32_t run, rows;
+    for (uint64_t pos = data_begin, begin = pos; ReadBlock(pos, run, data, rows); begin = pos)
+    {
+        if (index.empty() || index.back().run != run)
+            index.push_back({ run, begin, pos, rows });
+        else
+            index.back().end = pos, index.back().rows += rows;
+    }
+    in.clear();
+}
+
+// Read the block at pos, advancing pos past it, and return true, or return false if there is no block at pos
+bool TrajectoryReader::ReadBlock(uint64_t& pos, uint32_t& run, std::vector<char>& data, uint32_t& rows)
+{
+    uint32_t magic = 0;
+    uint8_t codec = 0;
+    uint64_t raw = 0, stored = 0;
+    in.clear();
+    in.seekg(pos);
+    if (!Get(in, magic) || magic != BlockMagic || !Get(in, run) || !Get(in, rows) || !Get(in, codec) || !Get(in, raw) || !Get(in, stored))
+        return false;
+
+    std::vector<char> packed(stored);
+    if (!in.read(packed.data(), stored))
+        return false;
+    if (codec == 0)
+        data.swap(packed);
+    else
+    {
+        data.resize(raw);
+        uLongf size = raw;
+        if (uncompress(reinterpret_cast<Bytef*>(data.data()), &size, reinterpret_cast<const Bytef*>(packed.data()), stored) != Z_OK || size != raw)
+            throw std::runtime_error("Could not decompress trajectory block");
+    }
+    pos += BlockHeader + stored;
+    return true;
+}
+
+void TrajectoryReader::WriteText(std::ostream& out, int run, bool header)
+{
+    if (header)
+    {
+        for (size_t c = 0; c < names.size(); ++c)
+            out << (c ? "\t" : "") << names[c];
+        out << "\n";
+    }
+    for (auto& e : index)
+        if (run < 0 || int(e.run) == run)
+            Read(e, [&](const std::vector<double>& row)
+            {
+                for (size_t c = 0; c < row.size(); ++c)
+                {
+                    out << (c ? "\t" : "");
+                    if (types[c] == Int32)
+                        out << int32_t(row[c]);
+                    else
+                        out << row[c];
+                }
+                out << "\n";
+            });
+}
@@ -0,0 +1,115 @@
+// trajectory.h
+// Binary columnar trajectory files: the rows reported by tinyhost, stored
+// with typed columns in blocks, with an index from each run to its bytes.
+//
+// Layout (all values little-endian):
+//   header  "THTRAJ01", uint32 number of columns, then for each column a
+//           uint8 type (0 int32, 1 float64), uint16 name length and name
+//   blocks  uint32 "TBLK", uint32 run, uint32 rows, uint8 codec (0 none,
+//           1 zlib), uint64 raw size, uint64 stored size, then the stored
+//           data: the block's values column by column, compressed if the
+//           codec says so
+//   footer  uint64 number of index entries, then for each contiguous run of
+//           blocks from one run: uint32 run, uint64 begin and end offsets,
+//           uint64 rows; then uint64 offset of the footer and "THTRIDX1"
+//
+// The footer is appended when a file is finished (FinishTrajectory). A
+// file without one, e.g. after a crash, can still be read; the reader then
+// scans the blocks instead.
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <fstream>
+
+enum ColumnType : uint8_t { Int32 = 0, Float64 = 1 };
+
+// TrajectoryWriter: writes the rows of one run to out as blocks of up to block_rows rows, compressed with zlib at
+// level compress (0 for no compression)
+class TrajectoryWriter
+{
+public:
+    TrajectoryWriter(std::ostream& out, const std::vector<ColumnType>& types, int run, int compress = 0, int block_rows = 1024);
+
+    static void WriteHeader(std::ostream& out, const std::vector<std::string>& names, const std::vector<ColumnType>& types);
+
+    // Add a row, given one value per column, and write out a block if it is full
+    void Add(const std::vector<double>& row);
+
+    // Write out any rows not yet written
+    void Flush();
+
+private:
+    std::ostream& out;
+    std::vector<ColumnType> types;
+    int run, compress, block_rows, rows;
+    std::vector<std::vector<char>> columns;
+};
+
+// Append the index to trajectory file filename, replacing any index already there; does nothing to other files
+void FinishTrajectory(const std::string& filename);
+
+// TrajectoryReader: reads a trajectory file
+class TrajectoryReader
+{
+public:
+    struct Entry { uint32_t run; uint64_t begin, end, rows; };
+
+    TrajectoryReader(const std::string& filename);
+
+    static bool IsTrajectory(const std::string& filename);
+
+    const std::vector<std::string>& Names() const   { return names; }
+    const std::vector<ColumnType>& Types() const    { return types; }
+    const std::vector<Entry>& Index() const         { return index; }
+
+    // Call f(row) for each row of the blocks in entry e, with one value per column
+    template <typename F>
+    void Read(const Entry& e, F f);
+
+    // Write the rows of the given run, or of all runs if run < 0, as tab-separated text as written by tinyhost
+    void WriteText(std::ostream& out, int run = -1, bool header = true);
+
+private:
+    bool ReadBlock(uint64_t& pos, uint32_t& run, std::vector<char>& data, uint32_t& rows);
+
+    std::ifstream in;
+    std::vector<std::string> names;
+    std::vector<ColumnType> types;
+    std::vector<Entry> index;
+    uint64_t data_begin;
+};
+
+template <typename F>
+void TrajectoryReader::Read(const Entry& e, F f)
+{
+    std::vector<char> data;
+    std::vector<double> row(types.size());
+    uint32_t run, rows;
+    for (uint64_t pos = e.begin; pos < e.end && ReadBlock(pos, run, data, rows); )
+    {
+        std::vector<const char*> column(types.size());
+        const char* p = data.data();
+        for (size_t c = 0; c < types.size(); ++c)
+        {
+            column[c] = p;
+            p += rows * (types[c] == Int32 ? 4 : 8);
+        }
+        for (uint32_t r = 0; r < rows; ++r)
+        {
+            for (size_t c = 0; c < types.size(); ++c)
+                if (types[c] == Int32)
+                    row[c] = reinterpret_cast<const int32_t*>(column[c])[r];
+                else
+                    row[c] = reinterpret_cast<const double*>(column[c])[r];
+            f(row);
+        }
+    }
+}
+
+#endif
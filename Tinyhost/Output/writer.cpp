@@ -0,0 +1,259 @@
+// writer.cpp
+
+#include "writer.h"
+#include <filesystem>
+
+std::vector<std::string> Columns(int n_strains)
+{
+    std::vector<std::string> columns;
+    for (int e = 0; e < n_strains / 2; ++e)
+    {
+        columns.push_back(std::string(1 + e / 26, char('A' + e % 26)) + "s");
+        columns.push_back(std::string(1 + e / 26, char('A' + e % 26)) + "r");
+    }
+    columns.insert(columns.end(), { "mult", "carr0", "carr1", "carr2", "carr3", "carr4", "carr5", "carr6", "carr7", "carr8plus" });
+    return columns;
+}
+
+void ReportFormatter::Begin(const ReportFormat& f)
+{
+    Flush();
+    trajectory.reset();
+    types.clear();
+    format = f;
+    count = 0;
+}
+
+void ReportFormatter::Write(const Report& r, std::ostream& screen, std::ostream& out, bool& header)
+{
+    std::string head;
+    if (types.empty() || header)    // Work out the columns on a run's first report
+    {
+        std::vector<std::string> names = { "run", "tau", "t" };
+        types = { Int32, Float64, Float64 };
+        if (r.replicate >= 0)
+        {
+            names.insert(names.begin() + 1, "rep");
+            types.insert(types.begin() + 1, Int32);
+        }
+        for (auto& c : Columns(r.values.size() - 10))
+        {
+            names.push_back(c);
+            types.push_back(c.compare(0, 4, "carr") == 0 ? Int32 : Float64);
+        }
+        if (header)
+        {
+            header = false;
+            for (size_t c = 0; c < names.size(); ++c)
+                head += (c ? "\t" : "") + names[c];
+            head += "\n";
+            if (format.binary)
+                TrajectoryWriter::WriteHeader(out, names, types);
+        }
+        if (format.binary)
+            trajectory.reset(new TrajectoryWriter(out, types, r.run, format.compress));
+    }
+
+    sout << r.run << "\t";
+    if (r.replicate >= 0)
+        sout << r.replicate << "\t";
+    sout << r.tau << "\t" << r.t;
+    for (size_t c = 0, first = types.size() - r.values.size(); c < r.values.size(); ++c)
+    {
+        if (types[first + c] == Int32)
+            sout << "\t" << int(r.values[c]);
+        else
+            sout << "\t" << r.values[c];
+    }
+
+    if (format.echo > 0)
+    {
+        if (count++ % format.echo == 0)
+            screen << head << sout.str() << "\n";
+        else
+            screen << head;
+    }
+    if (trajectory)
+    {
+        row.assign({ double(r.run), r.tau, r.t });
+        if (r.replicate >= 0)
+            row.insert(row.begin() + 1, r.replicate);
+        row.insert(row.end(), r.values.begin(), r.values.end());
+        trajectory->Add(row);
+    }
+    else
+        out << head << sout.str() << "\n";
+    sout.str(std::string());
+}
+
+void ReportFormatter::Flush()
+{
+    if (trajectory)
+        trajectory->Flush();
+}
+
+FileWriter::FileWriter(std::ostream& screen, bool async, int capacity)
+ : screen(screen), header(false), closed(false), length(0), ring(capacity), head(0), tail(0),
+   worker_waiting(false), caller_waiting(false), failed(false)
+{
+    if (async)
+        worker = std::thread(&FileWriter::Work, this);
+}
+
+FileWriter::~FileWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void FileWriter::Open(const std::string& filename, int64_t length)
+{
+    Slot().kind = OpenFile;
+    Slot().filename = filename;
+    Slot().length = length;
+    Push();
+}
+
+void FileWriter::Begin(const ReportFormat& f)
+{
+    Slot().kind = BeginRun;
+    Slot().format = f;
+    Push();
+}
+
+void FileWriter::Add(const Report& r)
+{
+    Slot().kind = AddReport;
+    Slot().report = r;      // Reuses the slot's storage
+    Push();
+}
+
+int64_t FileWriter::Sync()
+{
+    Slot().kind = SyncFile;
+    Push();
+    if (worker.joinable())
+        Wait(caller_waiting, done, [&]() { return tail == head; });
+    Check();
+    return length;
+}
+
+void FileWriter::Close()
+{
+    if (closed)
+        return;
+    closed = true;
+    Slot().kind = CloseFile;
+    Push();
+    if (worker.joinable())
+        worker.join();
+    Check();
+}
+
+// Hand over the command in the next slot: carry it out now if not async, or wait for room in the ring for the next
+void FileWriter::Push()
+{
+    if (!worker.joinable())
+    {
+        Execute(Slot());
+        ++head, ++tail;
+        return Check();
+    }
+
+    ++head;
+    Wake(worker_waiting, pushed);
+    Wait(caller_waiting, done, [&]() { return head - tail < ring.size(); });
+    Check();
+}
+
+void FileWriter::Execute(Command& c)
+{
+    if (failed)     // After an error, only stop
+        return;
+    try
+    {
+        switch (c.kind)
+        {
+            case OpenFile:
+            case CloseFile:
+                formatter.Flush();
+                if (fout.is_open())
+                    fout.close(), FinishTrajectory(filename);
+                if (c.kind == CloseFile)
+                    break;
+                filename = c.filename;
+                header = c.length <= 0;
+                if (header)
+                    fout.open(filename);
+                else
+                {
+                    std::filesystem::resize_file(filename, c.length);
+                    fout.open(filename, std::ios::app);
+                }
+                break;
+            case BeginRun:
+                formatter.Begin(c.format);
+                break;
+            case AddReport:
+                formatter.Write(c.report, screen, fout, header);
+                break;
+            case SyncFile:
+                formatter.Flush();
+                fout.flush();
+                screen.flush();
+                length = fout.tellp();
+                break;
+        }
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+        failed = true;
+    }
+}
+
+void FileWriter::Work()
+{
+    for (bool quit = false; !quit; )
+    {
+        Wait(worker_waiting, pushed, [&]() { return tail != head; });
+        Command& c = ring[tail % ring.size()];
+        Execute(c);
+        quit = c.kind == CloseFile;
+        ++tail;
+        Wake(caller_waiting, done);
+    }
+}
+
+void FileWriter::Check()
+{
+    if (failed)
+        std::rethrow_exception(error);
+}
+
+// Sleep until ready() if it is not true already. The waiting flag is raised under the mutex before ready() is checked,
+// and Wake checks the flag after making ready() true, so one side always sees the other.
+template <typename F>
+void FileWriter::Wait(std::atomic<bool>& waiting, std::condition_variable& cv, F ready)
+{
+    if (ready())
+        return;
+    std::unique_lock<std::mutex> lock(mutex);
+    waiting = true;
+    cv.wait(lock, ready);
+    waiting = false;
+}
+
+void FileWriter::Wake(std::atomic<bool>& waiting, std::condition_variable& cv)
+{
+    if (waiting)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_one();
+    }
+}
@@ -0,0 +1,159 @@
+// writer.h
+// Output of reports. The simulation hands over each report unformatted, as
+// a Report; a ReportSink formats it as text for the screen and as text or a
+// binary trajectory (see trajectory.h) for the output file. StreamWriter
+// writes reports to a pair of streams as they come, on the calling thread.
+// FileWriter owns the output file, finishing it and starting a new one when
+// asked, and with async does all its formatting and writing on a background
+// thread, fed through a single-producer single-consumer ring of commands, so
+// that a slow file system does not hold up the simulation. The ring itself is
+// lock-free; a mutex is only taken to wake a side that has gone to sleep
+// waiting for the other.
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include "trajectory.h"
+
+// Names of the reported columns following run, tau and t
+std::vector<std::string> Columns(int n_strains);
+
+// Report: one reported row
+struct Report
+{
+    int run, replicate;             // Replicate is -1 if the run is not replicated
+    double tau, t;
+    std::vector<double> values;     // One per column of Columns(n_strains)
+};
+
+// ReportFormat: how a run's reports are written: to fileout as binary (compressed at level compress) or text, and
+// every echo-th report to the screen (none if echo is 0)
+struct ReportFormat
+{
+    bool binary;
+    int compress, echo;
+};
+
+// ReportFormatter: writes reports to screen and to an output stream
+class ReportFormatter
+{
+public:
+    // Start a new run's reports, in format f
+    void Begin(const ReportFormat& f);
+
+    // Write r, preceded by the header if header is set (then clearing it)
+    void Write(const Report& r, std::ostream& screen, std::ostream& out, bool& header);
+
+    // Write out any binary rows held back
+    void Flush();
+
+private:
+    ReportFormat format = { false, 0, 1 };
+    std::unique_ptr<TrajectoryWriter> trajectory;
+    std::vector<ColumnType> types;
+    std::vector<double> row;
+    std::ostringstream sout;
+    long long count = 0;
+};
+
+// ReportSink: where a run sends its reports
+class ReportSink
+{
+public:
+    virtual ~ReportSink() { }
+
+    // Start a new run's reports, in format f
+    virtual void Begin(const ReportFormat& f) = 0;
+
+    virtual void Add(const Report& r) = 0;
+
+    // Write out all reports so far, flushing the output file, and return its length
+    virtual int64_t Sync() = 0;
+};
+
+// StreamWriter: writes reports to screen and out on the calling thread, with the header first if header is set
+class StreamWriter : public ReportSink
+{
+public:
+    StreamWriter(std::ostream& screen, std::ostream& out, bool header) : screen(screen), out(out), header(header) { }
+
+    void Begin(const ReportFormat& f) override      { formatter.Begin(f); }
+    void Add(const Report& r) override              { formatter.Write(r, screen, out, header); }
+    int64_t Sync() override                         { formatter.Flush(); out.flush(); return out.tellp(); }
+
+private:
+    std::ostream& screen;
+    std::ostream& out;
+    bool header;
+    ReportFormatter formatter;
+};
+
+// FileWriter: writes reports to screen and to the file last opened, on a background thread if async, holding up to
+// capacity commands not yet carried out. Errors on the background thread are thrown from the next call to Add, Sync
+// or Close.
+class FileWriter : public ReportSink
+{
+public:
+    FileWriter(std::ostream& screen, bool async, int capacity = 256);
+    ~FileWriter();
+
+    // Finish the current file, if any, and switch to filename: a new file starting with a header if length <= 0 (as
+    // nothing, not even the header, has been written at length 0), or an existing file cut back to length bytes and
+    // appended to
+    void Open(const std::string& filename, int64_t length = -1);
+
+    void Begin(const ReportFormat& f) override;
+    void Add(const Report& r) override;
+    int64_t Sync() override;
+
+    // Finish the current file and stop the background thread
+    void Close();
+
+private:
+    enum Kind { OpenFile, BeginRun, AddReport, SyncFile, CloseFile };
+    struct Command
+    {
+        Kind kind;
+        std::string filename;
+        int64_t length;
+        ReportFormat format;
+        Report report;
+    };
+
+    Command& Slot()     { return ring[head % ring.size()]; }
+    void Push();
+    void Execute(Command& c);
+    void Work();
+    void Check();
+    template <typename F> void Wait(std::atomic<bool>& waiting, std::condition_variable& cv, F ready);
+    void Wake(std::atomic<bool>& waiting, std::condition_variable& cv);
+
+    std::ostream& screen;
+    std::ofstream fout;
+    std::string filename;
+    bool header, closed;
+    ReportFormatter formatter;
+    int64_t length;                                     // Length of the file at the last SyncFile
+
+    std::vector<Command> ring;
+    std::atomic<uint64_t> head, tail;                   // Commands pushed and carried out
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable pushed, done;
+    std::atomic<bool> worker_waiting, caller_waiting, failed;
+    std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// parallel.cpp
+
+#include "parallel.h"
+#include <stdexcept>
+
+ThreadPool::ThreadPool(int n_threads)
+ : task(nullptr), generation(0), pending(0), quit(false)
+{
+    Resize(n_threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+// Sets the number of threads, including the calling thread; existing workers are joined and restarted.
+void ThreadPool::Resize(int n_threads)
+{
+    if (n_threads < 1)
+        throw std::runtime_error("ThreadPool needs at least one thread.");
+    if (n_threads == Size())
+        return;
+
+    Stop();
+    quit = false;
+    for (int t = 1; t < n_threads; ++t)
+        threads.emplace_back(&ThreadPool::Work, this, t, generation);
+}
+
+int ThreadPool::Size() const
+{
+    return threads.size() + 1;
+}
+
+void ThreadPool::Run(const std::function<void(int)>& f)
+{
+    if (threads.empty())
+    {
+        f(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &f;
+        pending = threads.size();
+        ++generation;
+    }
+    start.notify_all();
+
+    std::exception_ptr e;
+    try
+    {
+        f(0);
+    }
+    catch (...)
+    {
+        e = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+    if (!e)
+        e = error;
+    error = nullptr;
+    if (e)
+        std::rethrow_exception(e);
+}
+
+void ThreadPool::Work(int t, unsigned long long seen)
+{
+    for (;;)
+    {
+        const std::function<void(int)>* f;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start.wait(lock, [&] { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+            f = task;
+        }
+
+        std::exception_ptr e;
+        try
+        {
+            (*f)(t);
+        }
+        catch (...)
+        {
+            e = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (e && !error)
+            error = e;
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    start.notify_all();
+    for (auto& th : threads)
+        th.join();
+    threads.clear();
+}
@@ -0,0 +1,54 @@
+// parallel.h
+// Persistent pool of worker threads, used to split per-time-step loops
+// over hosts without paying thread start-up costs on every step.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    ThreadPool(int n_threads = 1);
+    ~ThreadPool();
+
+    void Resize(int n_threads);
+    int Size() const;
+
+    // Calls task(t) for t = 0 ... Size() - 1, each on its own thread, and returns when all calls have finished.
+    // Task 0 runs on the calling thread. If any call throws, one exception (task 0's, else the first caught from a
+    // worker) is rethrown once all calls have finished.
+    void Run(const std::function<void(int)>& task);
+
+    // Splits [begin, end) into Size() contiguous chunks and calls f(t, chunk_begin, chunk_end) for each chunk t.
+    template <typename F>
+    void For(long long begin, long long end, F f);
+
+private:
+    void Work(int t, unsigned long long seen);
+    void Stop();
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start, done;
+    const std::function<void(int)>* task;
+    std::exception_ptr error;
+    unsigned long long generation;
+    int pending;
+    bool quit;
+};
+
+template <typename F>
+void ThreadPool::For(long long begin, long long end, F f)
+{
+    long long n = Size();
+    Run([&](int t) { f(t, begin + (end - begin) * t / n, begin + (end - begin) * (t + 1) / n); });
+}
+
+#endif
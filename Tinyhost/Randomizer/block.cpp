@@ -0,0 +1,213 @@
+// block.cpp
+
+#include "block.h"
+#include <immintrin.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+typedef uint64_t (*State)[BlockEngine::Lanes];
+static const int L = BlockEngine::Lanes;
+
+static inline uint64_t Rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static void FillScalar(State s, uint64_t* out, size_t n)
+{
+    uint64_t s0[L], s1[L], s2[L], s3[L];
+    for (int j = 0; j < L; ++j)
+        { s0[j] = s[0][j]; s1[j] = s[1][j]; s2[j] = s[2][j]; s3[j] = s[3][j]; }
+
+    for (size_t i = 0; i < n; i += L)
+        for (int j = 0; j < L; ++j)
+        {
+            out[i + j] = Rotl(s0[j] + s3[j], 23) + s0[j];
+            uint64_t t = s1[j] << 17;
+            s2[j] ^= s0[j];
+            s3[j] ^= s1[j];
+            s1[j] ^= s2[j];
+            s0[j] ^= s3[j];
+            s2[j] ^= t;
+            s3[j] = Rotl(s3[j], 45);
+        }
+
+    for (int j = 0; j < L; ++j)
+        { s[0][j] = s0[j]; s[1][j] = s1[j]; s[2][j] = s2[j]; s[3][j] = s3[j]; }
+}
+
+// AVX2: lanes 0-3 and 4-7 in two sets of registers
+__attribute__((target("avx2")))
+static inline __m256i Rotl256(__m256i x, int k)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+__attribute__((target("avx2")))
+static void FillAVX2(State s, uint64_t* out, size_t n)
+{
+    __m256i s0[2], s1[2], s2[2], s3[2];
+    for (int h = 0; h < 2; ++h)
+    {
+        s0[h] = _mm256_load_si256((const __m256i*)(s[0] + 4 * h));
+        s1[h] = _mm256_load_si256((const __m256i*)(s[1] + 4 * h));
+        s2[h] = _mm256_load_si256((const __m256i*)(s[2] + 4 * h));
+        s3[h] = _mm256_load_si256((const __m256i*)(s[3] + 4 * h));
+    }
+
+    for (size_t i = 0; i < n; i += L)
+        for (int h = 0; h < 2; ++h)
+        {
+            __m256i r = _mm256_add_epi64(Rotl256(_mm256_add_epi64(s0[h], s3[h]), 23), s0[h]);
+            _mm256_storeu_si256((__m256i*)(out + i + 4 * h), r);
+            __m256i t = _mm256_slli_epi64(s1[h], 17);
+            s2[h] = _mm256_xor_si256(s2[h], s0[h]);
+            s3[h] = _mm256_xor_si256(s3[h], s1[h]);
+            s1[h] = _mm256_xor_si256(s1[h], s2[h]);
+            s0[h] = _mm256_xor_si256(s0[h], s3[h]);
+            s2[h] = _mm256_xor_si256(s2[h], t);
+            s3[h] = Rotl256(s3[h], 45);
+        }
+
+    for (int h = 0; h < 2; ++h)
+    {
+        _mm256_store_si256((__m256i*)(s[0] + 4 * h), s0[h]);
+        _mm256_store_si256((__m256i*)(s[1] + 4 * h), s1[h]);
+        _mm256_store_si256((__m256i*)(s[2] + 4 * h), s2[h]);
+        _mm256_store_si256((__m256i*)(s[3] + 4 * h), s3[h]);
+    }
+}
+
+// AVX-512: all eight lanes in one register, with native rotates
+__attribute__((target("avx512f")))
+static void FillAVX512(State s, uint64_t* out, size_t n)
+{
+    __m512i s0 = _mm512_load_si512(s[0]), s1 = _mm512_load_si512(s[1]), s2 = _mm512_load_si512(s[2]), s3 = _mm512_load_si512(s[3]);
+
+    for (size_t i = 0; i < n; i += L)
+    {
+        _mm512_storeu_si512(out + i, _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(s0, s3), 23), s0));
+        __m512i t = _mm512_slli_epi64(s1, 17);
+        s2 = _mm512_xor_si512(s2, s0);
+        s3 = _mm512_xor_si512(s3, s1);
+        s1 = _mm512_xor_si512(s1, s2);
+        s0 = _mm512_xor_si512(s0, s3);
+        s2 = _mm512_xor_si512(s2, t);
+        s3 = _mm512_rol_epi64(s3, 45);
+    }
+
+    _mm512_store_si512(s[0], s0); _mm512_store_si512(s[1], s1); _mm512_store_si512(s[2], s2); _mm512_store_si512(s[3], s3);
+}
+
+BlockEngine::BlockEngine()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        fill = FillAVX512, name = "avx512";
+    else if (__builtin_cpu_supports("avx2"))
+        fill = FillAVX2, name = "avx2";
+    else
+        fill = FillScalar, name = "scalar";
+
+    std::seed_seq seq;
+    seed(seq);
+}
+
+// Seeds lane 0 from seq, and each further lane with the previous lane's state advanced by 2^128 draws
+void BlockEngine::seed(std::seed_seq& seq)
+{
+    static const uint64_t jump[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+
+    uint32_t v[8];
+    seq.generate(v, v + 8);
+    uint64_t x[4];
+    for (int w = 0; w < 4; ++w)
+        x[w] = (uint64_t(v[2 * w]) << 32) | v[2 * w + 1];
+    if (!(x[0] | x[1] | x[2] | x[3]))
+        x[0] = 1;
+
+    for (int j = 0; j < L; ++j)
+    {
+        for (int w = 0; w < 4; ++w)
+            s[w][j] = x[w];
+
+        uint64_t y[4] = { 0, 0, 0, 0 };
+        for (int w = 0; w < 4; ++w)
+            for (int b = 0; b < 64; ++b)
+            {
+                if (jump[w] & (uint64_t(1) << b))
+                    for (int z = 0; z < 4; ++z)
+                        y[z] ^= x[z];
+                uint64_t t = x[1] << 17;
+                x[2] ^= x[0]; x[3] ^= x[1]; x[1] ^= x[2]; x[0] ^= x[3]; x[2] ^= t;
+                x[3] = Rotl(x[3], 45);
+            }
+        for (int z = 0; z < 4; ++z)
+            x[z] = y[z];
+    }
+}
+
+void BlockEngine::FillUnit(double* out, size_t n)
+{
+    uint64_t* u = reinterpret_cast<uint64_t*>(out);
+    fill(s, u, n);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (u[i] >> 11) * 0x1p-53;
+}
+
+RandomBuffer::RandomBuffer(size_t capacity)
+ : capacity((capacity + 2 * L - 1) / (2 * L) * (2 * L)), pos(0), end(0)
+{
+    words = static_cast<uint32_t*>(std::aligned_alloc(64, this->capacity * sizeof(uint32_t)));
+    if (!words)
+        throw std::bad_alloc();
+}
+
+RandomBuffer::~RandomBuffer()
+{
+    std::free(words);
+}
+
+void RandomBuffer::seed(std::seed_seq& seq)
+{
+    engine.seed(seq);
+    pos = end = 0;
+}
+
+void RandomBuffer::Reserve(size_t n)
+{
+    size_t r = end - pos;
+    if (r >= std::min(n, capacity))
+        return;
+
+    if (r % 2)  // Keep the remaining words 64-bit aligned, discarding one if needed
+        ++pos, --r;
+    std::memmove(words, words + pos, r * sizeof(uint32_t));
+    size_t m = (capacity - r) / (2 * L) * L;
+    engine.Fill(reinterpret_cast<uint64_t*>(words + r), m);
+    pos = 0;
+    end = r + 2 * m;
+}
+
+void RandomBuffer::Save(std::ostream& out) const
+{
+    engine.Save(out);
+    uint64_t r = end - pos;
+    out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    out.write(reinterpret_cast<const char*>(words + pos), r * sizeof(uint32_t));
+}
+
+void RandomBuffer::Load(std::istream& in)
+{
+    engine.Load(in);
+    uint64_t r = 0;
+    in.read(reinterpret_cast<char*>(&r), sizeof(r));
+    if (r > capacity)
+        throw std::runtime_error("Random number buffer in checkpoint is too large");
+    in.read(reinterpret_cast<char*>(words), r * sizeof(uint32_t));
+    pos = 0;
+    end = r;
+}
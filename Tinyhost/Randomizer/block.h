@@ -0,0 +1,74 @@
+// block.h
+// Block generation of random numbers. BlockEngine runs eight interleaved
+// xoshiro256++ streams, lane j starting 2^128 draws after lane j - 1, and
+// fills buffers eight 64-bit words at a time, keeping the generator state
+// in registers throughout; the scalar, AVX2 or AVX-512 implementation is
+// chosen at run time according to the features of the CPU. RandomBuffer
+// holds a block of BlockEngine output and hands it out one 32-bit word at
+// a time, so it can be used as the bit generator behind Randomizer; it is
+// refilled in bulk when it runs out, or ahead of time by Reserve.
+
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <random>
+#include <limits>
+#include <istream>
+#include <ostream>
+
+class BlockEngine
+{
+public:
+    static const int Lanes = 8;
+
+    BlockEngine();
+    void seed(std::seed_seq& seq);
+
+    // Fill out with n uniform words or doubles on [0, 1); n must be a multiple of Lanes, or of 2 * Lanes for
+    // 32-bit words. Buffers aligned to 64 bytes are filled fastest.
+    void Fill(uint64_t* out, size_t n)      { fill(s, out, n); }
+    void Fill(uint32_t* out, size_t n)      { fill(s, reinterpret_cast<uint64_t*>(out), n / 2); }
+    void FillUnit(double* out, size_t n);
+
+    const char* Name() const                { return name; }
+
+    void Save(std::ostream& out) const      { out.write(reinterpret_cast<const char*>(s), sizeof(s)); }
+    void Load(std::istream& in)             { in.read(reinterpret_cast<char*>(s), sizeof(s)); }
+
+private:
+    alignas(64) uint64_t s[4][Lanes];
+    void (*fill)(uint64_t (*s)[Lanes], uint64_t* out, size_t n);
+    const char* name;
+};
+
+class RandomBuffer
+{
+public:
+    typedef uint32_t result_type;
+    static constexpr result_type min()      { return 0; }
+    static constexpr result_type max()      { return std::numeric_limits<result_type>::max(); }
+
+    RandomBuffer(size_t capacity = 1 << 14);
+    RandomBuffer(const RandomBuffer&) = delete;
+    RandomBuffer& operator=(const RandomBuffer&) = delete;
+    ~RandomBuffer();
+
+    void seed(std::seed_seq& seq);
+    result_type operator()()                { if (pos == end) Reserve(capacity); return words[pos++]; }
+
+    // Make sure at least n words (up to the capacity of the buffer) are ready, refilling in bulk if not
+    void Reserve(size_t n);
+
+    // Write or read the generator state and the words not yet used
+    void Save(std::ostream& out) const;
+    void Load(std::istream& in);
+
+private:
+    BlockEngine engine;
+    size_t capacity, pos, end;
+    uint32_t* words;
+};
+
+#endif
@@ -0,0 +1,275 @@
+// engines.h
+// Random bit generators for Randomizer, and Engine, which selects among
+// them at run time:
+//   mt19937       Mersenne twister (std::mt19937); 2.5 KB of state
+//   xoshiro256++  Blackman & Vigna's xoshiro256++; 32 bytes of state
+//   pcg64         O'Neill's PCG XSL-RR 128/64; 32 bytes of state
+//   philox4x32    Salmon et al.'s counter-based Philox4x32-10; each
+//                 output block is a pure function of a counter and a key
+//   xoshiro256++x8  eight interleaved xoshiro256++ streams generated in
+//                 bulk with SIMD code into a buffer (see block.h)
+// Engine always yields 32-bit values, so that the same distributions
+// consume the same number of draws whichever engine is chosen; the 64-bit
+// generators are split into two 32-bit halves.
+
+#ifndef ENGINES_H
+#define ENGINES_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include "block.h"
+
+// Xoshiro256pp: xoshiro256++ 1.0
+class Xoshiro256pp
+{
+public:
+    typedef uint64_t result_type;
+    static constexpr result_type min()      { return 0; }
+    static constexpr result_type max()      { return std::numeric_limits<result_type>::max(); }
+
+    void seed(std::seed_seq& seq)
+    {
+        uint32_t v[8];
+        seq.generate(v, v + 8);
+        for (int i = 0; i < 4; ++i)
+            s[i] = (uint64_t(v[2 * i]) << 32) | v[2 * i + 1];
+        if (!(s[0] | s[1] | s[2] | s[3]))
+            s[0] = 1;
+    }
+
+    result_type operator()()
+    {
+        uint64_t r = Rotl(s[0] + s[3], 23) + s[0], t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 45);
+        return r;
+    }
+
+private:
+    static uint64_t Rotl(uint64_t x, int k)  { return (x << k) | (x >> (64 - k)); }
+    uint64_t s[4];
+};
+
+// PCG64: 128-bit LCG with XSL-RR output (pcg64 in the PCG family)
+class PCG64
+{
+public:
+    typedef uint64_t result_type;
+    static constexpr result_type min()      { return 0; }
+    static constexpr result_type max()      { return std::numeric_limits<result_type>::max(); }
+
+    void seed(std::seed_seq& seq)
+    {
+        uint32_t v[8];
+        seq.generate(v, v + 8);
+        unsigned __int128 init = 0, stream = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            init = (init << 32) | v[i];
+            stream = (stream << 32) | v[4 + i];
+        }
+        state = 0;
+        inc = (stream << 1) | 1;
+        Step();
+        state += init;
+        Step();
+    }
+
+    result_type operator()()
+    {
+        Step();
+        uint64_t x = uint64_t(state >> 64) ^ uint64_t(state);
+        int r = int(state >> 122);
+        return (x >> r) | (x << ((64 - r) & 63));
+    }
+
+private:
+    void Step()
+    {
+        const unsigned __int128 mult = (unsigned __int128)(0x2360ED051FC65DA4ULL) << 64 | 0x4385DF649FCCF645ULL;
+        state = state * mult + inc;
+    }
+    unsigned __int128 state, inc;
+};
+
+// Philox4x32: Philox4x32-10, run in counter mode from a seeded key
+class Philox4x32
+{
+public:
+    typedef uint32_t result_type;
+    static constexpr result_type min()      { return 0; }
+    static constexpr result_type max()      { return std::numeric_limits<result_type>::max(); }
+
+    // Four 32-bit outputs as a function of counter c and key k
+    static void Block(const uint32_t c[4], const uint32_t k[2], uint32_t out[4])
+    {
+        uint32_t x0 = c[0], x1 = c[1], x2 = c[2], x3 = c[3], k0 = k[0], k1 = k[1];
+        for (int r = 0; r < 10; ++r)
+        {
+            uint64_t p0 = uint64_t(0xD2511F53) * x0, p1 = uint64_t(0xCD9E8D57) * x2;
+            uint32_t y0 = uint32_t(p1 >> 32) ^ x1 ^ k0, y2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+            x1 = uint32_t(p1); x3 = uint32_t(p0); x0 = y0; x2 = y2;
+            k0 += 0x9E3779B9; k1 += 0xBB67AE85;
+        }
+        out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+    }
+
+    void seed(std::seed_seq& seq)
+    {
+        seq.generate(key, key + 2);
+        counter[0] = counter[1] = counter[2] = counter[3] = 0;
+        used = 4;
+    }
+
+    result_type operator()()
+    {
+        if (used == 4)
+        {
+            Block(counter, key, out);
+            for (int i = 0; i < 4 && ++counter[i] == 0; ++i) ;
+            used = 0;
+        }
+        return out[used++];
+    }
+
+private:
+    uint32_t key[2], counter[4], out[4];
+    int used;
+};
+
+// Engine: one of the above, chosen by name at run time
+class Engine
+{
+public:
+    typedef uint32_t result_type;
+    static constexpr result_type min()      { return 0; }
+    static constexpr result_type max()      { return std::numeric_limits<result_type>::max(); }
+
+    static const std::vector<std::string>& Names()
+    {
+        static const std::vector<std::string> names = { "mt19937", "xoshiro256++", "pcg64", "philox4x32", "xoshiro256++x8" };
+        return names;
+    }
+
+    Engine() : kind(MT19937), have_half(false), draws(0) { }
+
+    void Select(const std::string& name)
+    {
+        for (unsigned int i = 0; i < Names().size(); ++i)
+            if (Names()[i] == name)
+                { kind = Kind(i); return; }
+        throw std::runtime_error("Unrecognized random number engine " + name);
+    }
+
+    const std::string& Name() const         { return Names()[kind]; }
+
+    void seed(std::seed_seq& seq)
+    {
+        switch (kind)
+        {
+            case MT19937:       mt.seed(seq);       break;
+            case Xoshiro:       xoshiro.seed(seq);  break;
+            case PCG:           pcg.seed(seq);      break;
+            case Philox:        philox.seed(seq);   break;
+            case Block:         block.seed(seq);    break;
+        }
+        have_half = false;
+    }
+
+    result_type operator()()
+    {
+        ++draws;
+        switch (kind)
+        {
+            case MT19937:       return mt();
+            case Philox:        return philox();
+            case Block:         return block();
+            default:
+                if (have_half)
+                    { have_half = false; return half; }
+                uint64_t r = kind == Xoshiro ? xoshiro() : pcg();
+                half = r >> 32;
+                have_half = true;
+                return uint32_t(r);
+        }
+    }
+
+    // Number of draws made since construction, for instrumentation (not part of the saved state)
+    uint64_t Draws() const                  { return draws; }
+
+    // Make sure at least n draws are ready in bulk, for a buffered engine
+    void Reserve(size_t n)                  { if (kind == Block) block.Reserve(n); }
+
+    // Write or read the full state of the selected engine in binary, for checkpoints
+    void Save(std::ostream& out) const
+    {
+        out.write(reinterpret_cast<const char*>(&kind), sizeof(kind));
+        out.write(reinterpret_cast<const char*>(&half), sizeof(half));
+        out.write(reinterpret_cast<const char*>(&have_half), sizeof(have_half));
+        switch (kind)
+        {
+            case MT19937:
+            {
+                std::ostringstream text;
+                text << mt;
+                uint32_t size = text.str().size();
+                out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                out.write(text.str().data(), size);
+                break;
+            }
+            case Xoshiro:       out.write(reinterpret_cast<const char*>(&xoshiro), sizeof(xoshiro));    break;
+            case PCG:           out.write(reinterpret_cast<const char*>(&pcg), sizeof(pcg));            break;
+            case Philox:        out.write(reinterpret_cast<const char*>(&philox), sizeof(philox));      break;
+            case Block:         block.Save(out);                                                        break;
+        }
+    }
+
+    void Load(std::istream& in)
+    {
+        in.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+        in.read(reinterpret_cast<char*>(&half), sizeof(half));
+        in.read(reinterpret_cast<char*>(&have_half), sizeof(have_half));
+        switch (kind)
+        {
+            case MT19937:
+            {
+                uint32_t size = 0;
+                in.read(reinterpret_cast<char*>(&size), sizeof(size));
+                std::string text(size, ' ');
+                in.read(&text[0], size);
+                std::istringstream(text) >> mt;
+                break;
+            }
+            case Xoshiro:       in.read(reinterpret_cast<char*>(&xoshiro), sizeof(xoshiro));    break;
+            case PCG:           in.read(reinterpret_cast<char*>(&pcg), sizeof(pcg));            break;
+            case Philox:        in.read(reinterpret_cast<char*>(&philox), sizeof(philox));      break;
+            case Block:         block.Load(in);                                                 break;
+            default:            throw std::runtime_error("Unrecognized random number engine in checkpoint");
+        }
+    }
+
+private:
+    enum Kind { MT19937, Xoshiro, PCG, Philox, Block };
+    Kind kind;
+    std::mt19937 mt;
+    Xoshiro256pp xoshiro;
+    PCG64 pcg;
+    Philox4x32 philox;
+    RandomBuffer block;
+    uint32_t half;
+    bool have_half;
+    uint64_t draws;
+};
+
+#endif
@@ -8,20 +8,44 @@
 #include <limits>
 #include <stdexcept>
 
+// A function-level static, so that it is ready for Randomizers constructed during static initialization
+const std::vector<uint32_t>& Randomizer::BuiltinSeed()
+{
+    static const std::vector<uint32_t> seed = { 120368978, 37761590, 364135833, 399444367, 298076336 };
+    return seed;
+}
+
 Randomizer::Randomizer()
- : seed({ 120368978, 37761590, 364135833, 399444367, 298076336 })
+ : seed(BuiltinSeed())
 {
     Reset();
 }
 
 void Randomizer::Reset()
 {
-    engine.seed(seed);/////
-    /////engine = _msws();
+    std::seed_seq seq(seed.begin(), seed.end());
+    engine.seed(seq);
     fast_bits = engine();
     fast_shift = 0;
 }
 
+// Restarts the random number stream from a new seed sequence.
+void Randomizer::Seed(const std::vector<uint32_t>& values)
+{
+    seed = values;
+    Reset();
+}
+
+// Switches to the named engine (see engines.h) and restarts the random number stream, unless already using it.
+void Randomizer::SetEngine(std::string name)
+{
+    if (name != engine.Name())
+    {
+        engine.Select(name);
+        Reset();
+    }
+}
+
 double Randomizer::Uniform(double min, double max)
 {
     if (min == max)
@@ -290,21 +314,30 @@ int Randomizer::Round(double x)
 
 // For a given positive handle, sets a probability p of trial success.
 // Then the method Event(handle) below will return true with probability p.
+// Successive trials draw a geometric number of failures to skip, so trials
+// with small p cost one random draw per success, and p = 0 or 1 none.
 void Randomizer::SetEventRate(unsigned int handle, double p)
 {
     if (handle >= event_distributions.size())
     {
+        event_p.resize(handle + 1);
         event_distributions.resize(handle + 1);
         steps_to_next_event.resize(handle + 1);
     }
 
-    event_distributions[handle] = std::geometric_distribution<unsigned int>(p);
-    steps_to_next_event[handle] = event_distributions[handle](engine);
+    event_p[handle] = p;
+    if (p > 0 && p < 1)
+    {
+        event_distributions[handle] = std::geometric_distribution<unsigned int>(p);
+        steps_to_next_event[handle] = event_distributions[handle](engine);
+    }
 }
 
 bool Randomizer::Event(unsigned int handle)
 {
-    if (event_distributions[handle].p() > 0 && steps_to_next_event[handle]-- == 0)
+    if (event_p[handle] <= 0 || event_p[handle] >= 1)
+        return event_p[handle] >= 1;
+    if (steps_to_next_event[handle]-- == 0)
     {
         steps_to_next_event[handle] = event_distributions[handle](engine);
         return true;
@@ -313,10 +346,10 @@ bool Randomizer::Event(unsigned int handle)
 }
 
 
-void Randomizer::DiehardOutput(const char* filename)
+void Randomizer::DiehardOutput(const char* filename, long long bytes)
 {
-    std::ofstream out(filename);
-    for (int i = 0; i < 12000000;)
+    std::ofstream out(filename, std::ios::binary);
+    for (long long i = 0; i < bytes;)
     {
         auto k = engine();
         out.write(reinterpret_cast<char*>(&k), sizeof(k));
@@ -578,3 +611,38 @@ double Randomizer::FoundressPoisson_LogLambda[256] = {
     -1.8471556211944450965, -1.9534727482714073776, -2.0722028139462080887, -2.2066717185478532670, -2.3617504547707843798, 
     -2.5449906739549490453, -2.7690435543599964952, -3.0576256824558680769, -3.4639816317729938966, -4.1580104972824383225, -1000
 };
+
+void Randomizer::Save(std::ostream& out) const
+{
+    auto put = [&](const void* p, size_t n) { out.write(reinterpret_cast<const char*>(p), n); };
+    uint32_t n_seed = seed.size(), n_events = event_p.size();
+    put(&n_seed, sizeof(n_seed));
+    put(seed.data(), n_seed * sizeof(uint32_t));
+    engine.Save(out);
+    put(&fast_bits, sizeof(fast_bits));
+    put(&fast_shift, sizeof(fast_shift));
+    put(&n_events, sizeof(n_events));
+    put(event_p.data(), n_events * sizeof(double));
+    put(steps_to_next_event.data(), n_events * sizeof(unsigned int));
+}
+
+void Randomizer::Load(std::istream& in)
+{
+    auto get = [&](void* p, size_t n) { in.read(reinterpret_cast<char*>(p), n); };
+    uint32_t n_seed = 0, n_events = 0;
+    get(&n_seed, sizeof(n_seed));
+    seed.resize(n_seed);
+    get(seed.data(), n_seed * sizeof(uint32_t));
+    engine.Load(in);
+    get(&fast_bits, sizeof(fast_bits));
+    get(&fast_shift, sizeof(fast_shift));
+    get(&n_events, sizeof(n_events));
+    event_p.resize(n_events);
+    steps_to_next_event.resize(n_events);
+    get(event_p.data(), n_events * sizeof(double));
+    get(steps_to_next_event.data(), n_events * sizeof(unsigned int));
+    event_distributions.assign(n_events, std::geometric_distribution<unsigned int>());
+    for (uint32_t h = 0; h < n_events; ++h)
+        if (event_p[h] > 0 && event_p[h] < 1)
+            event_distributions[h] = std::geometric_distribution<unsigned int>(event_p[h]);
+}
@@ -4,30 +4,28 @@
 #ifndef RANDOMIZER_H
 #define RANDOMIZER_H
 
+#include <algorithm>
 #include <random>
 #include <vector>
 #include <limits>
-
-// struct _msws    // Middle square Weyl sequence RNG
-// {
-// public:
-//     typedef uint32_t result_type;
-//     static result_type min() { return std::numeric_limits<result_type>::min(); }
-//     static result_type max() { return std::numeric_limits<result_type>::max(); }
-
-//     _msws() : x(0), w(0), s(0xb5ad4eceda1ce2a9) { }
-//     result_type operator()() { x *= x; x += (w += s); return x = (x >> 32) | (x << 32); }
-
-// private:
-//     uint64_t x, w, s;
-// };
+#include <string>
+#include <istream>
+#include <ostream>
+#include "engines.h"
 
 class Randomizer
 {
 public:
     Randomizer();
 
+    static const std::vector<uint32_t>& BuiltinSeed();     // Seed sequence until another is given
+
     void Reset();
+    void Seed(const std::vector<uint32_t>& values);
+    void SetEngine(std::string name);
+    std::string EngineName() const          { return engine.Name(); }
+    void Reserve(size_t n)                  { engine.Reserve(n); }     // With a buffered engine, ready n draws in bulk
+    uint64_t Draws() const                  { return engine.Draws(); } // Number of 32-bit draws made so far
 
     double Uniform(double min = 0.0, double max = 1.0);
     double Normal(double mean = 0.0, double sd = 1.0);
@@ -54,27 +52,64 @@ public:
     int Round(double x);
     void SetEventRate(unsigned int handle, double p);
     bool Event(unsigned int handle);
+
+    // Fast paths for inner loops: Bounded(n) is uniform on 0 to n - 1 (Lemire's nearly divisionless method),
+    // Trial(Cutoff(p)) is true with probability p, to within 2^-32, with the cutoff computed once per p, Unit()
+    // is uniform on [0, 1) with 53 random bits, and Bits() is 32 raw random bits.
+    unsigned int Bounded(unsigned int n);
+    static uint64_t Cutoff(double p);
+    bool Trial(uint64_t cutoff)             { return engine() < cutoff; }
+    double Unit()                           { uint64_t hi = engine(); return ((hi << 32 | engine()) >> 11) * 0x1p-53; } // Uniform on [0, 1)
+    uint32_t Bits()                         { return engine(); }
     template <typename RandomAccessIterator>
     void Shuffle(RandomAccessIterator first, RandomAccessIterator last, int n = -1);
 
-    void DiehardOutput(const char* filename);
+    void DiehardOutput(const char* filename, long long bytes = 12000000);
+
+    // Write or read the full state of the random number stream in binary, for checkpoints
+    void Save(std::ostream& out) const;
+    void Load(std::istream& in);
 
 private:
     double LambertW0(const double x);
     static double FoundressPoisson_LogLambda[256];
 
-    typedef std::mt19937 engine_type;/////
-    /////typedef _msws engine_type;
-    std::seed_seq seed;
+    typedef Engine engine_type;
+    std::vector<uint32_t> seed;
     engine_type engine;
 
     engine_type::result_type fast_bits;
     int fast_shift;
 
+    std::vector<double> event_p;
     std::vector<std::geometric_distribution<unsigned int>> event_distributions;
     std::vector<unsigned int> steps_to_next_event;
 };
 
+// Uniform integer on 0 to n - 1 from 32-bit generator g, by Lemire's nearly divisionless method
+template <typename Generator>
+inline unsigned int BoundedDraw(Generator& g, unsigned int n)
+{
+    uint64_t m = uint64_t(g()) * n;
+    if (uint32_t(m) < n)
+    {
+        uint32_t t = -n % n;    // Reject the 2^32 mod n lowest values to remove bias
+        while (uint32_t(m) < t)
+            m = uint64_t(g()) * n;
+    }
+    return m >> 32;
+}
+
+inline unsigned int Randomizer::Bounded(unsigned int n)
+{
+    return BoundedDraw(engine, n);
+}
+
+inline uint64_t Randomizer::Cutoff(double p)
+{
+    return p <= 0 ? 0 : p >= 1 ? uint64_t(1) << 32 : uint64_t(p * 4294967296.0);
+}
+
 template <typename RandomAccessIterator>
 void Randomizer::Shuffle(RandomAccessIterator first, RandomAccessIterator last, int n)
 {
@@ -0,0 +1,137 @@
+// samplers.h
+// Reusable Poisson and binomial samplers that keep their setup between
+// draws, for means drawn from repeatedly. Large means use Hormann's
+// transformed rejection with squeeze: PTRS for the Poisson and BTRS for
+// the binomial (W. Hormann, "The transformed rejection method for
+// generating Poisson random variables", Insurance: Mathematics and
+// Economics 12, 1993; and "The generation of binomial random variates",
+// J. Stat. Comput. Simul. 46, 1993). Small means use inversion.
+//
+// Both keep their setup only while they are asked for the same mean, as
+// step lengths are often fixed. Reusing it for nearby means would need an
+// exact correction draw, which costs more than PTRS setup does. Setup
+// depends only on the mean, so draws do not depend on what was cached.
+
+#ifndef SAMPLERS_H
+#define SAMPLERS_H
+
+#include <cmath>
+#include "randomizer.h"
+
+// BinomialSampler: Binomial(n, p) variates
+class BinomialSampler
+{
+public:
+    int operator()(Randomizer& R, int n, double p)
+    {
+        if (n <= 0 || p <= 0) return 0;
+        if (p >= 1) return n;
+        if (p > 0.5) return n - (*this)(R, n, 1 - p);
+        if (n * p < Small) return Inversion(R, n, p);
+
+        if (n != n0 || p != p0)
+            Setup(n, p);
+        while (true)
+        {
+            double U = R.Unit() - 0.5, V = R.Unit(), us = 0.5 - std::fabs(U);
+            int k = std::floor((2 * a / us + b) * U + c);
+            if (k < 0 || k > n)
+                continue;
+            if (us >= 0.07 && V <= vr)
+                return k;
+            if (std::log(V * alpha / (a / (us * us) + b)) <= h - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0) + (k - m) * lpq)
+                return k;
+        }
+    }
+
+    // Binomial(n, p) by inversion, for small n * p
+    static int Inversion(Randomizer& R, int n, double p)
+    {
+        if (n <= 0 || p <= 0) return 0;
+        double q = 1 - p, r = p / q, f = std::pow(q, n), u = R.Unit();
+        int k = 0;
+        while (u >= f && k < n)
+        {
+            u -= f;
+            f *= r * (n - k) / (k + 1);
+            ++k;
+        }
+        return k;
+    }
+
+    static constexpr double Small = 10;     // Mean below which inversion is used
+
+private:
+    void Setup(int n, double p)
+    {
+        double q = 1 - p, spq = std::sqrt(n * p * q);
+        n0 = n; p0 = p;
+        b = 1.15 + 2.53 * spq;
+        a = -0.0873 + 0.0248 * b + 0.01 * p;
+        c = n * p + 0.5;
+        alpha = (2.83 + 5.1 / b) * spq;
+        vr = 0.92 - 4.2 / b;
+        m = std::floor((n + 1) * p);
+        lpq = std::log(p / q);
+        h = std::lgamma(m + 1) + std::lgamma(n - m + 1);
+    }
+
+    int n0 = -1;
+    double p0 = -1, a, b, c, alpha, vr, m, lpq, h;
+};
+
+// PoissonSampler: Poisson(mu) variates
+class PoissonSampler
+{
+public:
+    int operator()(Randomizer& R, double mu)
+    {
+        if (mu <= 0) return 0;
+        if (mu < Small) return Inversion(R, mu);
+
+        if (mu != mu0)
+            Setup(mu);
+        while (true)
+        {
+            double U = R.Unit() - 0.5, V = R.Unit(), us = 0.5 - std::fabs(U);
+            int k = std::floor((2 * a / us + b) * U + mu0 + 0.43);
+            if (us >= 0.07 && V <= vr)
+                return k;
+            if (k < 0 || (us < 0.013 && V > us))
+                continue;
+            if (std::log(V) + log_inv_alpha - std::log(a / (us * us) + b) <= -mu0 + k * log_mu - std::lgamma(k + 1.0))
+                return k;
+        }
+    }
+
+    // Poisson(mu) by inversion, for small mu
+    static int Inversion(Randomizer& R, double mu)
+    {
+        double f = std::exp(-mu), u = R.Unit();
+        int k = 0;
+        while (u >= f && f > 0)
+        {
+            u -= f;
+            f *= mu / ++k;
+        }
+        return k;
+    }
+
+    static constexpr double Small = 10;     // Mean below which inversion is used
+
+private:
+    void Setup(double mu)
+    {
+        double smu = std::sqrt(mu);
+        mu0 = mu;
+        log_mu = std::log(mu);
+        b = 0.931 + 2.53 * smu;
+        a = -0.059 + 0.02483 * b;
+        log_inv_alpha = std::log(1.1239 + 1.1328 / (b - 3.4));
+        vr = 0.9277 - 3.6224 / (b - 2);
+    }
+
+    double mu0 = 0, log_mu, a, b, log_inv_alpha, vr;
+};
+
+#endif
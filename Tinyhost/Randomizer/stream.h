@@ -0,0 +1,52 @@
+// stream.h
+// CounterStream: the random numbers used by one event, as a pure function
+// of a key and the event's coordinates (a step and an index within it),
+// drawn from Philox4x32-10 in counter mode. Each event gets its own
+// stream, so events can be executed by any thread in any order with the
+// same results. CounterStream offers the subset of the Randomizer
+// interface that event execution uses.
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include "engines.h"
+#include "randomizer.h"
+
+class CounterStream
+{
+public:
+    // event_cutoffs[h] is the cutoff for Event(h), as set by Randomizer::SetEventRate
+    CounterStream(const uint32_t key[2], uint64_t step, uint32_t index, const uint64_t* event_cutoffs)
+     : key(key), event_cutoffs(event_cutoffs), used(4)
+    {
+        counter[0] = 0;
+        counter[1] = index;
+        counter[2] = uint32_t(step);
+        counter[3] = uint32_t(step >> 32);
+    }
+
+    uint32_t operator()()
+    {
+        if (used == 4)
+        {
+            Philox4x32::Block(counter, key, out);
+            ++counter[0];
+            used = 0;
+        }
+        return out[used++];
+    }
+
+    unsigned int Bounded(unsigned int n)    { return BoundedDraw(*this, n); }
+    bool Trial(uint64_t cutoff)             { return (*this)() < cutoff; }
+    bool Event(unsigned int handle)         { return Trial(event_cutoffs[handle]); }
+    uint64_t Draws() const                  { return uint64_t(counter[0]) * 4 + used - 4; }  // Number of 32-bit draws made so far
+
+private:
+    const uint32_t* key;
+    const uint64_t* event_cutoffs;
+    uint32_t counter[4], out[4];
+    int used;
+};
+
+#endif
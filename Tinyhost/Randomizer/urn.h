@@ -0,0 +1,71 @@
+// urn.h
+// Urn: draws balls one at a time, without replacement, from an urn holding
+// a given number of balls of each colour. The colours drawn form a uniformly
+// random ordering of the balls, as if they had been listed and shuffled,
+// without the list ever being made. Remaining counts are held in a Fenwick
+// tree, so each draw takes O(log n_colours) time.
+
+#ifndef URN_H
+#define URN_H
+
+#include <vector>
+#include "randomizer.h"
+
+class Urn
+{
+public:
+    // Empty the urn and set the number of colours
+    void Clear(int n_colours)
+    {
+        n = n_colours;
+        tree.assign(n + 1, 0);
+        total = 0;
+        for (top = 1; top * 2 <= n; top *= 2) ;
+    }
+
+    // Add count balls of colour c
+    void Add(int c, unsigned int count)
+    {
+        for (int i = c + 1; i <= n; i += i & -i)
+            tree[i] += count;
+        total += count;
+    }
+
+    // Number of balls left
+    unsigned int Size() const               { return total; }
+
+    // Number of balls of colour c left
+    unsigned int Count(int c) const
+    {
+        unsigned int n_c = 0;
+        for (int i = c + 1; i > 0; i -= i & -i)
+            n_c += tree[i];
+        for (int i = c; i > 0; i -= i & -i)
+            n_c -= tree[i];
+        return n_c;
+    }
+
+    // Remove a ball at random from a nonempty urn, returning its colour
+    int Draw(Randomizer& R)
+    {
+        unsigned int u = R.Bounded(total);
+        int c = 0;
+        for (int step = top; step > 0; step /= 2)   // Find colour c such that balls of colours < c number <= u
+            if (c + step <= n && tree[c + step] <= u)
+            {
+                c += step;
+                u -= tree[c];
+            }
+        for (int i = c + 1; i <= n; i += i & -i)
+            --tree[i];
+        --total;
+        return c;
+    }
+
+private:
+    int n = 0, top = 1;
+    std::vector<unsigned int> tree;
+    unsigned int total = 0;
+};
+
+#endif
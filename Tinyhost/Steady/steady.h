@@ -0,0 +1,146 @@
+// steady.h
+// Online detection of a steady state in a run's reported per-strain
+// population carriage, for stopping runs early. Reports before a burn-in
+// point (a proportion of the time so far) are discarded, and the rest are
+// split into a fixed number of equal batches, most recent last; batch
+// means (see e.g. A. M. Law, "Simulation Modeling and Analysis", ch. 9)
+// give each strain's mean carriage and a confidence half-width for it,
+// z times the standard error of the batch means. The run is steady once,
+// for every strain, the half-width is at most tol times total carriage and
+// the least-squares trend across batch means is not significant (|t| < z).
+// Sums of carriage are kept cumulatively, so each check costs one pass
+// over the batches, however many reports there are.
+
+#ifndef STEADY_H
+#define STEADY_H
+
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+class SteadyState
+{
+public:
+    SteadyState(double tol, int batches, double burnin, double z, double t_min)
+     : tol(tol), batches(batches), burnin(burnin), z(z), t_min(t_min), steady(false), t_steady(0) { }
+
+    // Add carriage l reported at time t, returning true once steady
+    bool Add(double t, const std::vector<double>& l)
+    {
+        const size_t S = l.size();
+        times.push_back(t);
+        sums.resize(times.size() * S);
+        for (size_t s = 0; s < S; ++s)
+            sums[(times.size() - 1) * S + s] = (times.size() > 1 ? sums[(times.size() - 2) * S + s] : 0) + l[s];
+        if (steady || t < t_min)
+            return steady;
+
+        // Batch the most recent reports after burn-in, at least two per batch
+        long long n = times.size() - (std::lower_bound(times.begin(), times.end(), burnin * t) - times.begin());
+        long long b = n / batches;
+        if (batches < 3 || b < 2)
+            return false;
+        long long first = times.size() - b * batches;
+
+        std::vector<double> mean(S), half(S);
+        double total = 0;
+        for (size_t s = 0; s < S; ++s)
+        {
+            double m = 0, ss = 0, sxy = 0, sxx = 0, xbar = (batches - 1) / 2.0;
+            auto sum = [&](long long k) { return k > 0 ? sums[(k - 1) * S + s] : 0; };
+            for (int j = 0; j < batches; ++j)
+                m += sum(first + (j + 1) * b) - sum(first + j * b);
+            m /= b * batches;
+            for (int j = 0; j < batches; ++j)
+            {
+                double y = (sum(first + (j + 1) * b) - sum(first + j * b)) / b - m;
+                ss += y * y;
+                sxy += (j - xbar) * y;
+                sxx += (j - xbar) * (j - xbar);
+            }
+            double slope = sxy / sxx, residual = std::max(0.0, ss - slope * sxy) / (batches - 2);
+            if (slope != 0 && (residual == 0 || std::fabs(slope) >= z * std::sqrt(residual / sxx)))
+                return false;   // Still trending
+            mean[s] = m;
+            half[s] = z * std::sqrt(ss / (batches - 1) / batches);
+            total += m;
+        }
+        for (auto h : half)
+            if (h > tol * total)
+                return false;
+
+        steady = true;
+        t_steady = t;
+        estimate = mean;
+        halfwidth = half;
+        return true;
+    }
+
+    bool Steady() const                             { return steady; }
+    double Time() const                             { return t_steady; }
+    const std::vector<double>& Estimate() const     { return estimate; }
+    const std::vector<double>& HalfWidth() const    { return halfwidth; }
+
+    // Write a header, given the names of the strains, and one row for the given run, of a tab-separated table of
+    // the time each run stopped, or NaN if it did not, and the estimate and half-width for each strain
+    static void WriteHeader(std::ostream& out, const std::vector<std::string>& strains)
+    {
+        out << "run\trep\ttau\tt_steady";
+        for (auto& s : strains)
+            out << "\t" << s << "\t" << s << "_half";
+        out << "\n";
+    }
+
+    void Write(std::ostream& out, int run, int replicate, double tau) const
+    {
+        out << run << "\t" << replicate << "\t" << tau << "\t" << (steady ? t_steady : NAN);
+        for (size_t s = 0, S = times.empty() ? 0 : sums.size() / times.size(); s < S; ++s)
+            out << "\t" << (steady ? estimate[s] : NAN) << "\t" << (steady ? halfwidth[s] : NAN);
+        out << "\n";
+    }
+
+    // Save and load the state of detection, for checkpoints
+    void Save(std::ostream& out) const
+    {
+        Put(out, times); Put(out, sums); Put(out, estimate); Put(out, halfwidth);
+        out.write(reinterpret_cast<const char*>(&steady), sizeof(steady));
+        out.write(reinterpret_cast<const char*>(&t_steady), sizeof(t_steady));
+    }
+
+    void Load(std::istream& in)
+    {
+        Get(in, times); Get(in, sums); Get(in, estimate); Get(in, halfwidth);
+        in.read(reinterpret_cast<char*>(&steady), sizeof(steady));
+        in.read(reinterpret_cast<char*>(&t_steady), sizeof(t_steady));
+    }
+
+private:
+    static void Put(std::ostream& out, const std::vector<double>& x)
+    {
+        uint64_t n = x.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(x.data()), n * sizeof(double));
+    }
+
+    static void Get(std::istream& in, std::vector<double>& x)
+    {
+        uint64_t n = 0;
+        in.read(reinterpret_cast<char*>(&n), sizeof(n));
+        x.resize(n);
+        in.read(reinterpret_cast<char*>(x.data()), n * sizeof(double));
+    }
+
+    double tol;
+    int batches;
+    double burnin, z, t_min;
+    std::vector<double> times, sums;            // Report times, and cumulative sums of carriage by report and strain
+    bool steady;
+    double t_steady;                            // Time at which the run became steady
+    std::vector<double> estimate, halfwidth;    // Mean carriage of each strain when steady, and its half-width
+};
+
+#endif
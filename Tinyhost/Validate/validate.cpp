@@ -0,0 +1,361 @@
+// validate.cpp
+// Statistical equivalence harness, run by make validate. Alternative
+// engines and modes (lazy and exact engines, parallel events, reduced
+// precision, adaptive steps, the sparse store, other random number engines)
+// change the random stream, so their output cannot be diffed against the
+// serial step engine; instead, for each of a fixed set of configurations
+// from Runs/, this runs the reference (serial step engine) and each
+// alternative as independent replicates with different seeds, and compares
+// the distributions across replicates of every reported column (per-strain
+// carriage, mult and the carr histogram) at every report time with two
+// two-sample tests: Kolmogorov-Smirnov and Mann-Whitney U. Effect sizes are
+// the KS distance D and Cohen's d (difference in means over the pooled
+// standard deviation). Most configurations cover the transient after
+// inoculation; "neu-long" runs half as many hosts for longer, reporting
+// sparsely, to compare engines near quasi-equilibrium, where lazy growth,
+// leaping and reduced precision have had time to drift. An alternative
+// fails on a configuration if any test is significant at level alpha after
+// a Bonferroni correction over all of that comparison's tests. The first
+// alternative is the reference itself with another seed, as a check on the
+// tests.
+//
+// Resuming from a checkpoint must reproduce a run bit-exactly, so the
+// "resume" configuration checks that byte for byte instead. Each case runs
+// tinyhost without checkpoints, then with checkpoints, then resumed from
+// the last checkpoint that run left, in text and binary format; binary
+// output is compared as converted back to text by trajconv, as checkpoints
+// end blocks early. The cases are a snapshot taken mid-run and one taken
+// at t = 0, before anything has been written to the output file.
+//
+// Usage: validate [-replicates n] [-hosts n] [-alpha a] [-tinyhost path] [-trajconv path] [-config name]...
+//                 [-alt "args"]... [-verbose]
+// -config limits the run to the named configurations (including resume),
+// -alt replaces the default alternatives, and -verbose lists every test.
+// Exits with status 1 if any alternative or resume check fails.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <filesystem>
+#include <iterator>
+#include <unistd.h>
+using namespace std;
+
+// Values of each column at each report, across replicates: samples[report][column]
+typedef vector<vector<vector<double>>> Samples;
+
+// Run tinyhost with the given arguments as replicates seeded from seed, and read back its reports, with the names of
+// their columns and their times
+Samples RunReplicates(const string& tinyhost, const string& args, int seed, const string& file, vector<string>& columns,
+    vector<double>& times)
+{
+    string command = tinyhost + " " + args + " -seed " + to_string(seed) + " -echo 0 -fileout " + file + " > /dev/null 2>&1";
+    if (system(command.c_str()) != 0)
+        throw runtime_error("Run failed: " + command);
+
+    ifstream in(file);
+    string line, field;
+    if (!getline(in, line))
+        throw runtime_error("No output from: " + command);
+    vector<string> names;
+    for (istringstream header(line); getline(header, field, '\t'); )
+        names.push_back(field);
+    const int first = 4;    // run, rep, tau and t come first
+    if (names.size() <= first || names[1] != "rep" || names[3] != "t")
+        throw runtime_error("Unexpected columns in " + file);
+    columns.assign(names.begin() + first, names.end());
+
+    Samples samples;
+    times.clear();
+    map<int, int> reports;  // Reports read so far for each replicate
+    while (getline(in, line))
+    {
+        vector<double> row;
+        for (istringstream values(line); getline(values, field, '\t'); )
+            row.push_back(stod(field));
+        int r = reports[int(row[1])]++;
+        if (r == (int)samples.size())
+        {
+            samples.emplace_back(columns.size());
+            times.push_back(row[3]);
+        }
+        for (size_t c = 0; c < columns.size(); ++c)
+            samples[r][c].push_back(row[first + c]);
+    }
+    return samples;
+}
+
+// Kolmogorov-Smirnov two-sample test: distance D, and asymptotic p-value (with Stephens' correction for small samples)
+void KolmogorovSmirnov(vector<double> a, vector<double> b, double& D, double& p)
+{
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    D = 0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size(); )
+    {
+        double x = min(a[i], b[j]);
+        while (i < a.size() && a[i] == x) ++i;
+        while (j < b.size() && b[j] == x) ++j;
+        D = max(D, fabs(double(i) / a.size() - double(j) / b.size()));
+    }
+    double n = sqrt(double(a.size()) * b.size() / (a.size() + b.size())), lambda = (n + 0.12 + 0.11 / n) * D;
+    p = 0;
+    for (int k = 1; k <= 100; ++k)
+    {
+        double term = 2 * (k % 2 ? 1 : -1) * exp(-2 * k * k * lambda * lambda);
+        p += term;
+        if (fabs(term) < 1e-12)
+            break;
+    }
+    p = lambda < 0.2 ? 1 : min(1.0, max(0.0, p));
+}
+
+// Mann-Whitney U test: two-sided p-value by the normal approximation, with ties and continuity corrected
+double MannWhitney(const vector<double>& a, const vector<double>& b)
+{
+    vector<pair<double, int>> all;
+    for (auto x : a) all.push_back({ x, 0 });
+    for (auto x : b) all.push_back({ x, 1 });
+    sort(all.begin(), all.end());
+    double n = all.size(), rank_a = 0, ties = 0;
+    for (size_t i = 0; i < all.size(); )
+    {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) ++j;
+        double t = j - i, rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k)
+            if (all[k].second == 0)
+                rank_a += rank;
+        ties += t * t * t - t;
+        i = j;
+    }
+    double na = a.size(), nb = b.size();
+    double U = rank_a - na * (na + 1) / 2, mean = na * nb / 2;
+    double var = na * nb / 12 * ((n + 1) - ties / (n * (n - 1)));
+    if (var <= 0)
+        return 1;
+    double z = max(0.0, fabs(U - mean) - 0.5) / sqrt(var);
+    return erfc(z / sqrt(2.0));
+}
+
+// Cohen's d of b relative to a
+double CohensD(const vector<double>& a, const vector<double>& b)
+{
+    auto moments = [](const vector<double>& x, double& mean, double& ss)
+    {
+        mean = accumulate(x.begin(), x.end(), 0.0) / x.size();
+        ss = 0;
+        for (auto y : x)
+            ss += (y - mean) * (y - mean);
+    };
+    double ma, sa, mb, sb;
+    moments(a, ma, sa);
+    moments(b, mb, sb);
+    double sd = sqrt((sa + sb) / (a.size() + b.size() - 2));
+    if (sd == 0)
+        return ma == mb ? 0 : copysign(numeric_limits<double>::infinity(), mb - ma);
+    return (mb - ma) / sd;
+}
+
+// Contents of file filename
+string Contents(const string& filename)
+{
+    ifstream in(filename, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// Check that tinyhost with the given arguments writes the same output with checkpoints as without, and again when
+// resumed from the last checkpoint it wrote; binary output is read back with trajconv
+void ResumeCheck(const string& tinyhost, const string& trajconv, const string& args, bool binary, const string& dir)
+{
+    string plain = dir + "/plain.out", out = dir + "/resumed.out", checkpoint = dir + "/resume.ckpt";
+    auto shell = [](const string& command)
+    {
+        if (system(command.c_str()) != 0)
+            throw runtime_error("Run failed: " + command);
+    };
+    auto run = [&](const string& file, const string& more)
+    {
+        shell(tinyhost + " " + args + (binary ? " -format binary" : "") + " -echo 0 -fileout " + file + " " + more + " > /dev/null 2>&1");
+        if (!binary)
+            return Contents(file);
+        shell(trajconv + " " + file + " > " + file + ".txt 2> /dev/null");
+        return Contents(file + ".txt");
+    };
+    filesystem::remove(checkpoint);
+    string reference = run(plain, "");
+    if (run(out, "-checkpoint " + checkpoint) != reference)
+        throw runtime_error("output with checkpoints differs from output without");
+    if (!filesystem::exists(checkpoint))
+        throw runtime_error("no checkpoint written");
+    if (run(out, "-resume " + checkpoint) != reference)
+        throw runtime_error("resumed output differs");
+}
+
+struct Test { string column; double t, D, p_ks, p_mw, d; };
+
+int main(int argc, char* argv[])
+{
+    string tinyhost = "./tinyhost", trajconv = "./trajconv";
+    int replicates = 50, hosts = 2000;
+    double alpha = 0.001;
+    bool verbose = false;
+    vector<string> only, alternatives;
+    for (int a = 1; a < argc; ++a)
+    {
+        string arg = argv[a];
+        if (arg == "-verbose")
+            verbose = true;
+        else if (a + 1 < argc && arg == "-replicates")  replicates = stoi(argv[++a]);
+        else if (a + 1 < argc && arg == "-hosts")       hosts = stoi(argv[++a]);
+        else if (a + 1 < argc && arg == "-alpha")       alpha = stod(argv[++a]);
+        else if (a + 1 < argc && arg == "-tinyhost")    tinyhost = argv[++a];
+        else if (a + 1 < argc && arg == "-trajconv")    trajconv = argv[++a];
+        else if (a + 1 < argc && arg == "-config")      only.push_back(argv[++a]);
+        else if (a + 1 < argc && arg == "-alt")         alternatives.push_back(argv[++a]);
+        else
+        {
+            cerr << "Usage: validate [-replicates n] [-hosts n] [-alpha a] [-tinyhost path] [-trajconv path] [-config name]...\n"
+                 << "                [-alt \"args\"]... [-verbose]\n";
+            return 1;
+        }
+    }
+    if (alternatives.empty())
+        alternatives = { "-engine lazy", "-engine exact", "-par_events strict -threads 2", "-par_events relaxed -threads 2",
+            "-precision float", "-precision fixed", "-adaptive true", "-store sparse", "-rng xoshiro256++x8" };
+    alternatives.insert(alternatives.begin(), "");
+
+    string ones60 = "1";
+    for (int s = 1; s < 60; ++s)
+        ones60 += ",1";
+    struct Config { string name, args; double hosts; };    // Name, config file, sweep and overrides, and hosts relative to -hosts
+    vector<Config> configs =
+    {
+        { "neu",        "Runs/1-Steps/neu.config.cfg 60 -t_max 2 -report 500", 1 },
+        { "whc",        "Runs/1-Steps/whc.config.cfg 40 -t_max 2 -report 500", 1 },
+        { "restrends",  "Runs/2-ResTrends/config.cfg 3 -theta 1,1,1,1,1,1,1,1,1,1 -t_max 2 -report 500", 1 },
+        { "serores",    "Runs/3-SeroRes/config.cfg 2 -theta " + ones60 + " -t_max 2 -report 500", 1 },
+        { "separate",   "Runs/4-SeparateTrends/config.cfg 1 -t_max 2 -report 500", 1 },
+        { "neu-long",   "Runs/1-Steps/neu.config.cfg 60 -t_step 0.01 -t_max 120 -report 3000", 0.5 }
+    };
+
+    string dir = (filesystem::temp_directory_path() / ("tinyhost_validate_" + to_string(getpid()))).string();
+    filesystem::create_directories(dir);
+    bool all_pass = true;
+    cout << "Each alternative against the serial step engine, " << replicates << " replicates of " << hosts
+         << " hosts each (fewer for long runs), alpha " << alpha << " per comparison (Bonferroni-corrected over its tests)\n";
+
+    for (auto& config : configs)
+    {
+        if (!only.empty() && find(only.begin(), only.end(), config.name) == only.end())
+            continue;
+        string base = config.args + " -n_hosts " + to_string(max(1, int(hosts * config.hosts))) + " -replicates " + to_string(replicates);
+        vector<string> columns;
+        vector<double> times;
+        Samples reference;
+        try
+        {
+            reference = RunReplicates(tinyhost, base, 1, dir + "/reference.txt", columns, times);
+        }
+        catch (exception& e)
+        {
+            cout << "ERROR " << config.name << ": " << e.what() << "\n";
+            all_pass = false;
+            continue;
+        }
+
+        for (auto& alt : alternatives)
+        {
+            string name = alt.empty() ? "(reference, another seed)" : alt;
+            vector<string> alt_columns;
+            vector<double> alt_times;
+            Samples other;
+            try
+            {
+                other = RunReplicates(tinyhost, base + " " + alt, 2, dir + "/alternative.txt", alt_columns, alt_times);
+                if (alt_columns != columns || alt_times != times)
+                    throw runtime_error("reports do not match the reference");
+            }
+            catch (exception& e)
+            {
+                cout << "ERROR " << config.name << " " << name << ": " << e.what() << "\n";
+                all_pass = false;
+                continue;
+            }
+
+            vector<Test> tests;
+            for (size_t r = 0; r < reference.size(); ++r)
+                for (size_t c = 0; c < columns.size(); ++c)
+                {
+                    Test test;
+                    test.column = columns[c];
+                    test.t = times[r];
+                    KolmogorovSmirnov(reference[r][c], other[r][c], test.D, test.p_ks);
+                    test.p_mw = MannWhitney(reference[r][c], other[r][c]);
+                    test.d = CohensD(reference[r][c], other[r][c]);
+                    tests.push_back(test);
+                }
+
+            double threshold = alpha / (2 * tests.size());
+            int failures = 0;
+            const Test* worst = &tests[0];
+            double max_D = 0, max_d = 0;
+            for (auto& test : tests)
+            {
+                bool fail = min(test.p_ks, test.p_mw) < threshold;
+                failures += fail;
+                if (min(test.p_ks, test.p_mw) < min(worst->p_ks, worst->p_mw))
+                    worst = &test;
+                max_D = max(max_D, test.D);
+                if (isfinite(test.d))
+                    max_d = max(max_d, fabs(test.d));
+                if (verbose || fail)
+                    cout << (fail ? "  fail\t" : "  \t") << config.name << "\t" << name << "\t" << test.column << "\tt " << test.t
+                         << "\tD " << test.D << "\tp_KS " << test.p_ks << "\tp_MW " << test.p_mw << "\td " << test.d << "\n";
+            }
+            all_pass = all_pass && failures == 0;
+            cout << (failures == 0 ? "PASS " : "FAIL ") << left << setw(10) << config.name << setw(32) << name << right
+                 << " tests " << 2 * tests.size() << ", failed " << failures << ", min p " << min(worst->p_ks, worst->p_mw)
+                 << " (" << worst->column << " at t = " << worst->t << "), max D " << max_D << ", max |d| " << max_d << "\n";
+        }
+    }
+
+    // Checkpoints every 0.02 s leave one from late in a run of about a second; an interval below the time to the first
+    // step leaves one from g = 0 if that is the only step
+    struct Resume { string name, args; };
+    vector<Resume> resumes =
+    {
+        { "mid-run",    "Runs/1-Steps/neu.config.cfg 60 -n_hosts 20000 -t_max 4 -report 100 -seed 1 -ckpt_interval 0.02" },
+        { "at t = 0",   "Runs/1-Steps/neu.config.cfg 60 -n_hosts 2000 -t_max 0 -seed 1 -ckpt_interval 1e-9" }
+    };
+    if (only.empty() || find(only.begin(), only.end(), "resume") != only.end())
+        for (auto& resume : resumes)
+            for (bool binary : { false, true })
+            {
+                string name = resume.name + (binary ? ", binary" : ", text");
+                try
+                {
+                    ResumeCheck(tinyhost, trajconv, resume.args, binary, dir);
+                    cout << "PASS " << left << setw(10) << "resume" << name << right << "\n";
+                }
+                catch (exception& e)
+                {
+                    cout << "FAIL " << left << setw(10) << "resume" << name << right << ": " << e.what() << "\n";
+                    all_pass = false;
+                }
+            }
+
+    filesystem::remove_all(dir);
+    cout << (all_pass ? "All alternatives and resume checks pass\n" : "Some alternatives or resume checks fail\n");
+    return all_pass ? 0 : 1;
+}
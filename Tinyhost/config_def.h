@@ -24,4 +24,38 @@ PARAMETER ( double,         t_max,          24 );           // how long to run t
 PARAMETER ( double,         t_step,         0.001 );        // time step granularity
 PARAMETER ( string,         fileout,        "./out.txt" );  // output file
 PARAMETER ( int,            report,         1000 );         // how often to save steps
-PARAMETER ( bool,           first_sero,     false );        // if true, only count first serotype when tallying number of carriers with 0, 1, 2, etc. strains
\ No newline at end of file
+PARAMETER ( bool,           first_sero,     false );        // if true, only count first serotype when tallying number of carriers with 0, 1, 2, etc. strains
+PARAMETER ( int,            threads,        1 );            // number of worker threads for the within-host growth pass (1 = serial)
+PARAMETER ( string,         simd,           "auto" );       // vector kernels for growth and normalization: auto (best for n_strains on this CPU), scalar, avx2 or avx512
+PARAMETER ( string,         store,          "dense" );      // host state store: dense (n_strains values per host) or sparse (list of nonzero values per host, for many strains)
+PARAMETER ( string,         precision,      "double" );     // storage of carriage values in the dense store: double, float or fixed (32-bit fixed point); see Hosts/hosts.h for error bounds
+PARAMETER ( string,         engine,         "step" );       // simulation engine: step (grow every host on every time step), lazy (grow hosts only when touched by events; see Hosts/lazy.h) or exact (continuous-time stochastic simulation with lazy growth)
+PARAMETER ( int,            resync,         0 );            // with engine lazy or exact, recompute population carriage exactly every resync steps as well as on report steps (0 = on report steps only)
+PARAMETER ( bool,           adaptive,       false );        // if true, each step spans a whole number of time steps, as many as the current event rates allow (see adapt_tol, adapt_events, t_step_max)
+PARAMETER ( double,         adapt_tol,      0.03 );         // with adaptive, maximum relative change in population carriage of any strain over one step
+PARAMETER ( double,         adapt_events,   0.05 );         // with adaptive, maximum expected number of events per host over one step
+PARAMETER ( double,         t_step_max,     0.1 );          // with adaptive, maximum length of one step
+PARAMETER ( string,         rng,            "mt19937" );    // random number engine: mt19937, xoshiro256++, pcg64 or philox4x32 (see Randomizer/engines.h; changing engine restarts the random number stream)
+PARAMETER ( string,         par_events,     "off" );        // execute each step's events across threads (step engine only): off, strict (same results as serial order with per-event random streams) or relaxed (conflicting events deferred); see tinyhost.cpp
+PARAMETER ( int,            sweep_threads,  1 );            // number of parameter sets (sweeps) run at once, each with its own random number stream seeded from seed and its sweep number; 1 runs sweeps one after another on one stream
+PARAMETER ( int,            seed,           0 );            // seed for random numbers; 0 uses the built-in seed. Sweeps run one after another continue one stream, restarting it whenever seed changes (from the built-in seed if it changes to 0). Replicate runs are seeded from seed, sweep number and replicate number
+PARAMETER ( int,            replicates,     1 );            // number of replicate runs of each parameter set, each with its own random number stream; with more than 1, an ensemble summary is written too
+PARAMETER ( vector<double>, quantiles,      { 0.025, 0.5, 0.975 } ); // quantiles of each reported column across replicates for the ensemble summary
+PARAMETER ( string,         fileensemble,   "" );           // file for the ensemble summary of replicates; empty for fileout with .ensemble before its extension (.txt if format is binary)
+PARAMETER ( string,         checkpoint,     "" );           // file for checkpoints of the step engine, written every ckpt_interval and on SIGUSR1 or SIGTERM (then stopping); empty for none
+PARAMETER ( double,         ckpt_interval,  0 );            // wall-clock seconds between checkpoints; 0 for checkpoints on signals only
+PARAMETER ( string,         resume,         "" );           // checkpoint to resume from, bit-exactly; other parameters must be as when it was written
+PARAMETER ( string,         mapfile,        "" );           // file to keep the dense carriage matrix in, memory-mapped, for populations larger than RAM (needs sweep_threads 1 and replicates 1, as runs reuse it); empty to keep it in memory
+PARAMETER ( bool,           map_warm,       false );        // if true, start from the carriage matrix already in mapfile (from a run of the same n_hosts, n_strains and precision) instead of inoculating
+PARAMETER ( string,         format,         "text" );       // format of fileout: text (tab-separated) or binary (typed columns in blocks, with an index of runs; see Output/trajectory.h, and trajconv to convert back to text)
+PARAMETER ( int,            compress,       0 );            // with format binary, zlib compression level for blocks of rows (0 for none, 1-9)
+PARAMETER ( bool,           async_output,   true );         // if true, format and write reports on a background thread, so that slow output does not hold up the simulation (sweep_threads 1 and replicates 1; see Output/writer.h)
+PARAMETER ( int,            echo,           1 );            // write every echo-th report to the screen as well as to fileout; 0 for none
+PARAMETER ( string,         stats,          "off" );        // instrumentation: off, on (time each phase of the main loop, count events by type and random draws) or perf (also cycles, cache misses and branch misses per phase, from perf_event_open); see Instruments/instruments.h
+PARAMETER ( string,         filestats,      "" );           // file for one row of instrumentation per run; empty for fileout with .stats before its extension (.txt if format is binary). A summary over all runs is printed at the end
+PARAMETER ( double,         steady_tol,     0 );            // stop each run once its reported per-strain carriage is steady: the confidence half-width of every strain's mean, by batch means, is at most steady_tol times total carriage, with no significant trend across batches (see Steady/steady.h); 0 to run to t_max
+PARAMETER ( int,            steady_batches, 20 );           // with steady_tol, number of batches of reports for batch means (at least 3)
+PARAMETER ( double,         steady_burnin,  0.5 );          // with steady_tol, proportion of the time so far whose reports are discarded as burn-in
+PARAMETER ( double,         steady_z,       2 );            // with steady_tol, critical value for half-widths and for the trend test
+PARAMETER ( double,         steady_t_min,   0 );            // with steady_tol, earliest time at which a run may stop
+PARAMETER ( string,         filesteady,     "" );           // with steady_tol, file for one row per run of the time it stopped and its estimated steady-state carriage of each strain, with half-widths; empty for fileout with .steady before its extension (.txt if format is binary)
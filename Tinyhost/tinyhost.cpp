@@ -3,169 +3,989 @@
 #include <sstream>
 #include <algorithm>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
 #include "Config/config.h"
 #include "Randomizer/randomizer.h"
+#include "Randomizer/urn.h"
+#include "Randomizer/samplers.h"
+#include "Randomizer/stream.h"
+#include "Parallel/parallel.h"
+#include "Kernels/kernels.h"
+#include "Hosts/hosts.h"
+#include "Hosts/lazy.h"
+#include "Ensemble/ensemble.h"
+#include "Output/trajectory.h"
+#include "Output/writer.h"
+#include "Instruments/instruments.h"
+#include "Steady/steady.h"
 using namespace std;
 
 Parameters P;
 Randomizer R;
 
+// Everything one parameter set runs with: parameters, random number stream, kernels, threads for within-step work, a
+// stream for messages to screen, and the sink for its reports (see Output/writer.h). For a replicate run,
+// replicate is its number (or -1 if not replicated), and each report's time and values are also added to rows. If
+// resume is set, the run picks up from the checkpoint it is reading (see main). If stats is set, the run's phases,
+// events and random draws are counted there. If steady is set, each report's carriage is added to it, and the run
+// stops once it is steady.
+struct Context
+{
+    Parameters& P;
+    Randomizer& R;
+    Kernels& K;
+    ThreadPool& pool;
+    ostream& screen;
+    ReportSink& sink;
+    int replicate;
+    vector<vector<double>>* rows;
+    istream* resume;
+    Instruments* stats;
+    SteadyState* steady;
+};
+
+// File named filename if given, or else fileout with tag before its extension, which becomes .txt if fileout is binary,
+// as these files are always text
+string Beside(const string& filename, const Parameters& P, const string& tag)
+{
+    if (!filename.empty())
+        return filename;
+    size_t dot = P.fileout.find_last_of('.'), slash = P.fileout.find_last_of('/');
+    bool has_ext = dot != string::npos && (slash == string::npos || dot > slash);
+    string base = has_ext ? P.fileout.substr(0, dot) : P.fileout;
+    if (P.format == "binary")
+        return base + tag + ".txt";
+    return base + tag + (has_ext ? P.fileout.substr(dot) : "");
+}
+
+// File for the ensemble summary of parameter set P: fileensemble, or fileout with ".ensemble" before its extension
+string EnsembleFile(const Parameters& P)
+{
+    return Beside(P.fileensemble, P, ".ensemble");
+}
+
+// Files for the logs of runs of parameter set P: filestats or filesteady, or fileout with ".stats" or ".steady" before
+// its extension
+string StatsFile(const Parameters& P)   { return Beside(P.filestats, P, ".stats"); }
+string SteadyFile(const Parameters& P)  { return Beside(P.filesteady, P, ".steady"); }
+
+// Length of log file filename if the log is kept (0 if the file does not exist yet), or -1 if not
+int64_t LogLength(bool kept, const string& filename)
+{
+    error_code error;
+    uintmax_t length = filesystem::file_size(filename, error);
+    return !kept ? -1 : error ? 0 : int64_t(length);
+}
+
+// Checkpoints. A checkpoint is written at the start of a step, periodically or on SIGTERM or SIGUSR1, and holds the run
+// number, the length of the output file, the run's parameters, the lengths of the stats and steady logs (see LogLength),
+// the state of the step engine, the random number stream and the hosts, all in binary. It is written to a temporary
+// file first, then renamed over the last checkpoint.
+const char CheckpointMagic[8] = "THCKPT3";
+volatile sig_atomic_t checkpoint_signal = 0;            // Signal received since the last checkpoint, if any
+struct Stop { };                                        // Thrown to stop the program after a checkpoint on SIGTERM
+
+void OnSignal(int signum)
+{
+    checkpoint_signal = signum;
+}
+
+template <typename T> void Put(ostream& out, const T& x)            { out.write(reinterpret_cast<const char*>(&x), sizeof(x)); }
+template <typename T> void Get(istream& in, T& x)                   { in.read(reinterpret_cast<char*>(&x), sizeof(x)); }
+template <typename T> void Put(ostream& out, const vector<T>& x)    { Put(out, uint64_t(x.size())); out.write(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(T)); }
+template <typename T> void Get(istream& in, vector<T>& x)           { uint64_t n = 0; Get(in, n); x.resize(n); in.read(reinterpret_cast<char*>(x.data()), n * sizeof(T)); }
+void Put(ostream& out, const string& x)                             { Put(out, uint64_t(x.size())); out.write(x.data(), x.size()); }
+void Get(istream& in, string& x)                                    { uint64_t n = 0; Get(in, n); x.resize(n); in.read(&x[0], n); }
+
+// Parameters as written out, less those that may differ when resuming from a checkpoint
+string Signature(const Parameters& P)
+{
+    ostringstream out, sig;
+    P.Write(out);
+    istringstream in(out.str());
+    for (string line; getline(in, line); )
+        if (line.compare(0, 11, "checkpoint ") && line.compare(0, 14, "ckpt_interval ") && line.compare(0, 7, "resume "))
+            sig << line << "\n";
+    return sig.str();
+}
+
 void Check(vector<double>& param, int size, string name) // Check parameter is correct size
 {
     if (param.size() != size)
         throw runtime_error("Incorrect size for parameter " + name);
 }
 
-void Normalize(double* x)   // Normalize carriage
+const int Transmission = 0, Clearance = 0x10000, Treatment = 0x20000, Birth = 0x30000, Transfer = 0x40000;    // Event types
+
+// Choose the number of time steps m spanned by the step starting at time step g, given population carriage l now and l0
+// at the start of the previous step of m0 time steps. The step is as long as possible, up to t_step_max, such that the
+// expected number of events per host is at most adapt_events and, extrapolating from the previous step, no strain's
+// population carriage changes by more than a proportion adapt_tol. Steps never cross a report time or t_max, and a
+// step starting at a report time spans one time step, as the report follows that step's events.
+int Leap(const Parameters& P, const vector<double>& l, const vector<double>& l0, int m0, int g, int g_max)
 {
-    double total = accumulate(x, x + P.n_strains, 0.0, [](double X, double x) { return X + (x > 0 ? x : 0); });
-    if (total > 0)
-        for (int s = 0; s < P.n_strains; ++s)
-            if (x[s] > 0)
-                x[s] /= total;
+    if (g % P.report == 0)
+        return 1;
+    double rate = P.tau + P.birth_rate + P.gamma;   // Events per host per unit time
+    for (int s = 0; s < (int)l.size(); ++s)
+        rate += P.beta[s] * l[s];
+    for (auto u : P.u)
+        rate += u;
+
+    double dt = P.t_step_max;
+    if (rate > 0)
+        dt = min(dt, P.adapt_events / rate);
+    for (int s = 0; s < (int)l0.size(); ++s)
+        if (l[s] != l0[s])
+            dt = min(dt, P.adapt_tol * l[s] * m0 * P.t_step / fabs(l[s] - l0[s]));
+
+    int m = max(1.0, floor(dt / P.t_step + 1e-6));
+    m = min(m, P.report - g % P.report);
+    return g < g_max ? min(m, g_max - g) : m;
 }
 
-int main(int argc, char* argv[])
+// Run one parameter set. The engine is specialized at compile time on the store used for host state (which may fix
+// the number of strains, or leave it to P.n_strains), on whether co-colonisation is blocked (P.k != 1), and on whether
+// clearance is immunising. With P.engine "lazy", hosts are grown only when touched by events (see Hosts/lazy.h). With
+// P.adaptive, each step spans a whole number of time steps chosen from current event rates (see Leap). P.engine "exact"
+// replaces steps with a continuous-time stochastic simulation of the same events, with lazy within-host growth.
+//
+// With P.par_events, the events of each step are executed across threads. Each event's type, target host and (for a
+// transfer) donor host are drawn serially from R, in the order events are drawn from the urn; every other random number
+// an event uses comes from its own counter-based stream (see Randomizer/stream.h), so results do not depend on which
+// thread runs it or when. "strict" executes events in levels: an event's level is one more than the highest level of
+// earlier events in the step touching either of its hosts, and each level (whose events touch disjoint hosts) runs in
+// parallel. This keeps the order of events at each host, so results are those of executing the events in urn order,
+// whatever the number of threads. "relaxed" runs one parallel batch of events whose hosts are not touched by an earlier
+// event in the batch, then the remaining (conflicting) events serially in urn order. A host's events within a step may
+// then be reordered, which changes results but not their distribution, since the order of events in a step is random.
+// Both differ from the serial engine (par_events "off") only in which random numbers events use.
+template <typename Hosts, bool Blocking, bool Immunity>
+void Simulate(int run, Context& C)
 {
-    const int Transmission = 0, Clearance = 0x10000, Treatment = 0x20000, Birth = 0x30000, Transfer = 0x40000;
-    int run = 0; string filename = "\n"; ofstream fout; ostringstream sout;
+    Parameters& P = C.P;
+    Randomizer& R = C.R;
+    ThreadPool& pool = C.pool;
+    typedef typename Hosts::Host Host;
+    const int n_strains = Hosts::Strains ? Hosts::Strains : P.n_strains;
+    const double iota = P.iota, sigma = P.sigma;
+    const uint64_t k = R.Cutoff(P.k), v = R.Cutoff(P.v);                                       // Cutoffs for R.Trial
 
-    // Iterate over parameter sets
-    for (P.Read(argc, argv); P.Good(); P.NextSweep(), ++run)
+    Hosts X(P.n_hosts, n_strains, C.K, P.mapfile, P.map_warm);                                  // Host state
+    vector<double> ww(n_strains), l(n_strains), l0;                                             // Per-step growth rates, population-level carriage now and one step ago
+    vector<int> types;                                                                          // Event types, in the order their rates are calculated
+    Urn events;                                                                                 // Events remaining in the current step, by index in types
+    vector<PoissonSampler> counts;                                                              // Samplers for the number of events of each type per step
+    vector<vector<double>> lt(pool.Size(), vector<double>(n_strains));                          // Per-thread population carriage accumulators
+
+    for (int i = 0, n = P.map_warm ? 0 : R.Poisson(P.n_hosts * P.init); i < n; ++i) // Inoculate hosts with a random strain at rate P.init, unless warm-starting
+        X[i].Set(R.Discrete(n_strains), 1);
+    for (int s = 0; s < n_strains; ++s)     types.push_back(Transmission | s);
+    for (int t = 0; t < n_strains / 2; ++t) types.push_back(Clearance | t);
+    types.insert(types.end(), { Treatment, Birth, Transfer });
+    counts.assign(types.size(), PoissonSampler());
+    for (int s = 0; s < n_strains; ++s)     // Transfer of strain s succeeds at R.Event(s)
+        R.SetEventRate(s, P.theta[s]);
+
+    struct Pending { int e; long long i, ii; };                                                 // Pre-drawn event type, target and donor, for parallel execution
+    vector<Pending> pending;
+    vector<long long> order, level_start;                                                       // Events sorted by level, and the start of each level in order
+    vector<int> levels, host_step, host_level;                                                  // Level of each event, last step touching each host, and level of its last event
+    vector<uint64_t> theta_cutoffs;                                                             // Transfer cutoffs for CounterStream::Event
+    vector<uint64_t> drawn;                                                                     // Per-thread draws by per-event streams this step
+    uint32_t key[2];                                                                            // Key for per-event random streams
+    if (P.par_events != "off")
     {
-        Check(P.w,     P.n_strains,     "w");
-        Check(P.beta,  P.n_strains,     "beta");
-        Check(P.theta, P.n_strains,     "theta");
-        Check(P.u,     P.n_strains / 2, "u");
+        host_step.assign(P.n_hosts, -1);
+        host_level.assign(P.n_hosts, 0);
+        for (int s = 0; s < n_strains; ++s)
+            theta_cutoffs.push_back(R.Cutoff(P.theta[s]));
+        key[0] = R.Bits();
+        key[1] = R.Bits();
+    }
+
+    unique_ptr<LazyGrowth<Hosts>> lazy;                                                         // Lazy growth, from time 0 (exact engine) or one step before (lazy engine)
+    if (P.engine != "step")
+    {
+        double t0 = P.engine == "exact" ? 0 : -P.t_step;
+        lazy.reset(new LazyGrowth<Hosts>(X, P.n_hosts, n_strains, P.w, P.t_step, P.min_carriage, t0));
+    }
+
+    // Execute event e at the given time on host i with donor ii (for a transfer), drawing each at random if negative,
+    // and with random numbers from rng (R, or a CounterStream)
+    auto execute = [&](int e, double time, long long i, long long ii, auto& rng)
+    {
+        bool normalize = false;
+        int j = e & 0xFFFF;
+        if (i < 0) i = rng.Bounded(P.n_hosts);
+        if (lazy) lazy->Touch(i, time);
+        Host x = X[i];
+        switch (e & 0xF0000)
+        {
+            case Transmission:  // Colonise host with strain j
+                if (!Blocking || !x.Colonised() || rng.Trial(k)) // If there is no blocking...
+                    if (!Immunity || x.Get(j) >= 0 || rng.Trial(R.Cutoff(1 + x.Get(j)))) // and no immunity...
+                        { x.Set(j, max(x.Get(j), 0.0) + iota); x.Normalize(); }
+                break;
+
+            case Clearance:     // Clear serotype j from host, possibly bringing other serotypes with it
+                if (x.Get(j * 2) > 0 || x.Get(j * 2 + 1) > 0)
+                {
+                    x.Set(j * 2, -sigma);
+                    x.Set(j * 2 + 1, -sigma);
+                    if (rng.Trial(v))
+                        x.Clear();
+                    x.Normalize();
+                }
+                break;
+
+            case Treatment:     // Eliminate all sensitive strains from host
+                if (x.Clear(0, 2))
+                    x.Normalize();
+                break;
 
-        vector<double> X(P.n_hosts * P.n_strains, 0.0), ww(P.n_strains), l(P.n_strains);    // Carriage matrix, per-time-step growth rates, population-level carriage
-        vector<int> events;                                                                 // Event storage
+            case Birth:         // Replace host with new, naive host
+                x.Reset();
+                break;
 
-        P.Write(cout);  // Print parameters
-        for (int s = 0; s < P.n_strains; ++s) // Calculate per-time-step growth rates
-            ww[s] = pow(P.w[s], P.t_step);
-        for (int i = 0, n = R.Poisson(P.n_hosts * P.init); i < n; ++i) // Inoculate hosts with a random strain at rate P.init
-            X[P.n_strains * i + R.Discrete(P.n_strains)] = 1;
+            case Transfer:      // Colonise host with strains carried by a random host
+                if (!Blocking || !x.Colonised() || rng.Trial(k)) // If there is no blocking...
+                {
+                    if (ii < 0) ii = rng.Bounded(P.n_hosts); // Choose contacted host
+                    if (lazy && ii != i) lazy->Touch(ii, time);
+                    Host xx = X[ii];
+                    x.ForEachTransfer(xx, [&](int s, double y)
+                    {
+                        if (!Immunity || x.Get(s) >= 0 || rng.Trial(R.Cutoff(1 + x.Get(s)))) // If there is no immunity...
+                            if (rng.Event(s)) // and transfer is successful ...
+                                { x.Set(s, max(x.Get(s), 0.0) + iota * y); normalize = true; }
+                    });
+                    if (normalize)
+                        x.Normalize();
+                    if (lazy && ii != i) lazy->Release(ii, time);
+                }
+                break;
+        }
+        if (lazy) lazy->Release(i, time);
+    };
+
+    // Tally hosts h0 to h1 - 1 by the number of strains they carry, counting only the first serotype if P.first_sero
+    struct Tally { vector<int> strain_count = vector<int>(9, 0); double mult = 0; };  // Hosts carrying 0-7 and 8+ strains, and total strains carried
+    const int tally_strains = P.first_sero ? 2 : n_strains;
+    auto tally = [&](long long h0, long long h1, Tally& y)
+    {
+        for (long long i = h0; i < h1; ++i)
+        {
+            int m = X[i].Carried(tally_strains);
+            y.mult += m;
+            ++y.strain_count[min(8, m)];
+        }
+    };
+    vector<Tally> tallies(pool.Size());                                                         // Per-thread tallies
+    auto tally_sync = [&](double time)      // Sync lazy growth, tallying each host as it is brought up to date
+    {
+        tallies.assign(pool.Size(), Tally());
+        lazy->Sync(time, pool, [&](int t, long long i) { tally(i, i + 1, tallies[t]); });
+    };
+    auto tallied = [&]() -> const Tally*    // Reduce per-thread tallies in thread order
+    {
+        for (size_t t = 1; t < tallies.size(); ++t)
+        {
+            tallies[0].mult += tallies[t].mult;
+            for (int k = 0; k < 9; ++k)
+                tallies[0].strain_count[k] += tallies[t].strain_count[k];
+        }
+        return &tallies[0];
+    };
+
+    // Report per-strain carriage l_report, average multiplicity of carriage, and distribution of multiplicity of carriage
+    // to screen and output file, from a tally of all hosts, made now unless given
+    Report rep = { run, C.replicate, P.tau, 0, {} };
+    C.sink.Begin({ P.format == "binary", P.compress, P.echo });
+    auto report = [&](double time, const vector<double>& l_report, const Tally* given = 0)
+    {
+        Instruments::Scope scope(C.stats, Instruments::Reporting);
+        Tally y;
+        if (given)
+            y = *given;
+        else
+            tally(0, P.n_hosts, y);
+        double carriers = P.n_hosts - y.strain_count[0];
 
-        // Iterate over each time step
-        for (int g = 0; g < P.t_max / P.t_step + 0.5; ++g)
+        rep.t = time;
+        rep.values.assign(l_report.begin(), l_report.end());
+        rep.values.push_back(y.mult / carriers);
+        rep.values.insert(rep.values.end(), y.strain_count.begin(), y.strain_count.end());
+        if (C.rows)
         {
-            // 1. Calculate force of infection for each strain and update hosts
-            fill(l.begin(), l.end(), 0.0);
-            for (int i = 0; i < P.n_strains * P.n_hosts; i += P.n_strains)
+            C.rows->push_back({ time });
+            C.rows->back().insert(C.rows->back().end(), rep.values.begin(), rep.values.end());
+        }
+        C.sink.Add(rep);
+        if (C.steady)
+            C.steady->Add(time, l_report);
+    };
+    auto steady = [&]() { return C.steady && C.steady->Steady(); };
+
+    const int g_max = ceil(P.t_max / P.t_step + 0.5) - 1;
+    if (P.engine == "exact")
+    {
+        // Exact engine: between report (or resync) times, draw the waiting time to the next event and its type from the
+        // current event rates, or stop at the next elimination check if it comes first. Event rates only change when
+        // events or checks change hosts, so the waiting time can simply be redrawn after each. Reports tally hosts as the
+        // sync at each report time brings them up to date.
+        vector<double> rates;                                                                   // Cumulative event rates
+
+        double time = 0;
+        for (int g = 0; g <= g_max; )
+        {
+            Instruments::Scope phase(C.stats, Instruments::Growth);
+            X.Sequential();
+            if (g % P.report == 0)
+                tally_sync(time);
+            else
+                lazy->Sync(time, pool);
+            X.Random();
+            for (int s = 0; s < n_strains; ++s)
+                l[s] = max(lazy->L[s], P.min_carriers) / P.n_hosts;
+            if (g % P.report == 0)
+                report(time, l, tallied());
+            int g_report = g / P.report * P.report + P.report;     // Stop once no report remains to be made
+            if (steady() || g_report > g_max)
+                break;
+
+            g = P.resync > 0 ? min(g_report, g / P.resync * P.resync + P.resync) : g_report;
+            double t_sync = g * P.t_step;
+            phase.Switch(Instruments::Events);
+            while (true)
             {
-                double total = 0;   // Enforce host minimum carriage, grow strains, and tally host carriage
-                for (int s = 0; s < P.n_strains; ++s)
-                    if (X[i + s] > 0)
-                        total += X[i + s] = (X[i + s] < P.min_carriage ? 0 : X[i + s] * ww[s]);
-
-                if (total > 0)      // Enforce host carrying capacity and tally population carriage
-                    for (int s = 0; s < P.n_strains; ++s)
-                        if (X[i + s] > 0)
-                            l[s] += X[i + s] /= total;
+                rates.clear();
+                double a = 0;
+                for (int s = 0; s < n_strains; ++s)     rates.push_back(a += P.beta[s] * max(lazy->L[s], P.min_carriers));
+                for (int t = 0; t < n_strains / 2; ++t) rates.push_back(a += P.n_hosts * P.u[t]);
+                rates.push_back(a += P.n_hosts * P.tau);
+                rates.push_back(a += P.n_hosts * P.birth_rate);
+                rates.push_back(a += P.n_hosts * P.gamma);
+
+                double t_event = a > 0 ? time + R.Exponential(a) : LazyGrowth<Hosts>::Never, t_check = lazy->NextCheck();
+                if (min(t_event, t_check) >= t_sync)
+                    break;
+                if (t_check <= t_event)
+                    lazy->Due(time = t_check, true);
+                else
+                {
+                    int e = types[R.Discrete(rates)];
+                    if (C.stats)
+                        C.stats->Executed(e >> 16, 1);
+                    execute(e, time = t_event, -1, -1, R);
+                }
             }
-            for (auto& ll : l)      // Calculate effective population carriage
-                ll = max(ll, P.min_carriers) / P.n_hosts;
-
-            // 2. Choose events and randomize their order
-            events.clear();
-            for (int s = 0; s < P.n_strains; ++s)   events.insert(events.end(), R.Poisson(P.n_hosts * P.beta[s] * l[s] * P.t_step), Transmission | s);
-            for (int t = 0; t < P.n_strains/2; ++t) events.insert(events.end(), R.Poisson(P.n_hosts * P.u[t] * P.t_step), Clearance | t);
-            events.insert(events.end(), R.Poisson(P.n_hosts * P.tau * P.t_step), Treatment);
-            events.insert(events.end(), R.Poisson(P.n_hosts * P.birth_rate * P.t_step), Birth);
-            events.insert(events.end(), R.Poisson(P.n_hosts * P.gamma * P.t_step), Transfer);
-            R.Shuffle(events.begin(), events.end());
-
-            // 3. Execute events
-            for (auto e : events)
+            time = t_sync;
+        }
+        C.sink.Sync();
+        return;
+    }
+
+    // Iterate over each step, spanning m time steps, having grown hosts over the previous step of m0 time steps, or
+    // when resuming, from the step at which the checkpoint was written. Without lazy growth, a report due at the end
+    // of a step waits for the growth pass of the next step, which tallies each tile of hosts just before growing it,
+    // so that reports add no separate pass over the hosts (except after the last step, or before a checkpoint).
+    int g = 0, m = 1, m0 = 1, mw = 0;
+    const long long Tile = 256;                                                                 // Hosts tallied then grown at a time
+    vector<double> l_report;                                                                    // Population carriage at the report waiting, if any
+    double t_report = -1;                                                                       // Time of the report waiting, or -1 if none
+    if (C.resume)
+    {
+        istream& in = *C.resume;
+        Get(in, g); Get(in, m0); Get(in, mw); Get(in, l0);
+        Get(in, key);
+        R.Load(in);
+        X.Load(in);
+        if (C.steady)
+            C.steady->Load(in);
+        if (!in)
+            throw runtime_error("Could not read checkpoint " + P.resume);
+        for (int s = 0; s < n_strains && mw > 0; ++s)
+            ww[s] = pow(P.w[s], mw * P.t_step);
+    }
+
+    auto last_checkpoint = chrono::steady_clock::now();
+    for (; g <= g_max && !steady(); g += m, m0 = m)
+    {
+        // 0. Write a checkpoint if one is due
+        if (!P.checkpoint.empty() && (checkpoint_signal ||
+            (P.ckpt_interval > 0 && chrono::duration<double>(chrono::steady_clock::now() - last_checkpoint).count() >= P.ckpt_interval)))
+        {
+            Instruments::Scope scope(C.stats, Instruments::Checkpointing);
+            if (t_report >= 0)
+                report(t_report, l_report), t_report = -1;
+            string temp = P.checkpoint + ".tmp";
+            int64_t length = C.sink.Sync();
+            ofstream out(temp, ios::binary);
+            out.write(CheckpointMagic, sizeof(CheckpointMagic));
+            Put(out, run); Put(out, length); Put(out, Signature(P));
+            Put(out, LogLength(P.stats != "off", StatsFile(P))); Put(out, LogLength(P.steady_tol > 0, SteadyFile(P)));
+            Put(out, g); Put(out, m0); Put(out, mw); Put(out, l0);
+            Put(out, key);
+            R.Save(out);
+            X.Save(out);
+            if (C.steady)
+                C.steady->Save(out);
+            out.close();
+            if (!out || rename(temp.c_str(), P.checkpoint.c_str()) != 0)
+                throw runtime_error("Could not write checkpoint " + P.checkpoint);
+            C.screen << "Checkpoint written to " << P.checkpoint << " at t = " << g * P.t_step << "\n";
+
+            last_checkpoint = chrono::steady_clock::now();
+            if (checkpoint_signal == SIGTERM)
+                throw Stop();
+            checkpoint_signal = 0;
+        }
+
+        // 1. Calculate force of infection for each strain and update hosts
+        Instruments::Scope phase(C.stats, Instruments::Growth);
+        double time = g * P.t_step, dt;
+        X.Sequential();
+        if (lazy)   // Update only hosts due an elimination check, unless an exact resync is due
+        {
+            if (g % P.report == 0 || (P.resync > 0 && g / P.resync != (g - m0) / P.resync))
+                lazy->Sync(time, pool);
+            else
+                lazy->Due(time);
+            l = lazy->L;
+        }
+        else
+        {
+            if (m0 != mw)           // Recalculate growth rates for the length of the previous step
             {
-                bool normalize = false;
-                int j = e & 0xFFFF;
-                double* x = X.data() + P.n_strains * R.Discrete(P.n_hosts);
-                switch (e & 0xF0000)
+                mw = m0;
+                for (int s = 0; s < n_strains; ++s)
+                    ww[s] = pow(P.w[s], mw * P.t_step);
+            }
+            pool.For(0, P.n_hosts, [&](int t, long long h0, long long h1)
+            {
+                fill(lt[t].begin(), lt[t].end(), 0.0);
+                if (t_report < 0)
+                    return X.Grow(h0, h1, ww.data(), P.min_carriage, lt[t].data());
+                tallies[t] = Tally();
+                for (long long i0 = h0; i0 < h1; i0 += Tile)
                 {
-                    case Transmission:  // Colonise host with strain j
-                        if (P.k == 1 || all_of(x, x + P.n_strains, [](double y) { return y <= 0; }) || R.Bernoulli(P.k)) // If there is no blocking...
-                            if (!P.immunity || x[j] >= 0 || R.Bernoulli(1 + x[j])) // and no immunity...
-                                { x[j] = max(x[j], 0.0) + P.iota; Normalize(x); }
-                        break;
-
-                    case Clearance:     // Clear serotype j from host, possibly bringing other serotypes with it
-                        if (x[j * 2] > 0 || x[j * 2 + 1] > 0)
-                        {
-                            x[j * 2] = x[j * 2 + 1] = -P.sigma;
-                            if (R.Bernoulli(P.v))
-                                for (int s = 0; s < P.n_strains; ++s)
-                                    if (x[s] > 0) x[s] = 0;
-                            Normalize(x);
-                        }
-                        break;
-                        
-                    case Treatment:     // Eliminate all sensitive strains from host
-                        for (int s = 0; s < P.n_strains; s += 2)
-                            if (x[s] > 0)
-                                { x[s] = 0; normalize = true; }
-                        if (normalize)
-                            Normalize(x);
-                        break;
-
-                    case Birth:         // Replace host with new, naive host
-                        fill(x, x + P.n_strains, 0.0);
-                        break;
-
-                    case Transfer:      // Colonise host with strains carried by a random host
-                        if (P.k == 1 || all_of(x, x + P.n_strains, [](double y) { return y <= 0; }) || R.Bernoulli(P.k)) // If there is no blocking...
-                        {
-                            double* xx = X.data() + P.n_strains * R.Discrete(P.n_hosts); // Choose contacted host
-                            for (int s = 0; s < P.n_strains; ++s)
-                                if (!P.immunity || x[s] >= 0 || R.Bernoulli(1 + x[s])) // If there is no immunity...
-                                    if (R.Bernoulli(P.theta[s])) // and transfer is successful ...
-                                        { x[s] = max(x[s], 0.0) + P.iota * xx[s]; normalize = true; }
-                            if (normalize)
-                                Normalize(x);
-                        }
-                        break;
+                    long long i1 = min(h1, i0 + Tile);
+                    tally(i0, i1, tallies[t]);
+                    X.Grow(i0, i1, ww.data(), P.min_carriage, lt[t].data());
                 }
+            });
+            for (int s = 0; s < n_strains; ++s)     // Reduce per-thread population carriage in thread order
+            {
+                l[s] = 0;
+                for (auto& ll : lt)
+                    l[s] += ll[s];
             }
+            if (t_report >= 0)      // Make the report waiting from the last step
+            {
+                report(t_report, l_report, tallied());
+                t_report = -1;
+            }
+        }
+        if (steady())           // Stop on the report just made
+            break;
+        for (auto& ll : l)      // Calculate effective population carriage
+            ll = max(ll, P.min_carriers) / P.n_hosts;
 
-            // 4. Report per-strain carriage, average multiplicity of carriage, and distribution of multiplicity of carriage to screen and output file
-            if (g % P.report == 0)
+        // 2. Choose the length of this step, then choose the number of events of each type
+        phase.Switch(Instruments::EventCounts);
+        m = P.adaptive ? Leap(P, l, l0, m0, g, g_max) : 1;
+        dt = m * P.t_step;
+        l0 = l;
+        events.Clear(types.size());
+        for (int s = 0; s < n_strains; ++s)     events.Add(s, counts[s](R, P.n_hosts * P.beta[s] * l[s] * dt));
+        for (int t = 0; t < n_strains / 2; ++t) events.Add(n_strains + t, counts[n_strains + t](R, P.n_hosts * P.u[t] * dt));
+        const int c = n_strains + n_strains / 2;
+        events.Add(c, counts[c](R, P.n_hosts * P.tau * dt));
+        events.Add(c + 1, counts[c + 1](R, P.n_hosts * P.birth_rate * dt));
+        events.Add(c + 2, counts[c + 2](R, P.n_hosts * P.gamma * dt));
+        if (C.stats)
+            for (size_t e = 0; e < types.size(); ++e)
+                C.stats->Executed(types[e] >> 16, events.Count(e));
+
+        // 3. Execute events in random order, with random numbers generated in bulk beforehand if possible. Serially,
+        // drawing events from the urn (the shuffle) is timed with executing them.
+        X.Random();
+        if (P.par_events == "off")
+        {
+            phase.Switch(Instruments::Events);
+            R.Reserve(events.Size() * (4 + n_strains));
+            while (events.Size() > 0)
+                execute(types[events.Draw(R)], time, -1, -1, R);
+        }
+        else
+        {
+            phase.Switch(Instruments::Shuffle);
+            R.Reserve(events.Size() * 4);
+            pending.clear();
+            while (events.Size() > 0)
             {
-                if (filename != P.fileout)  // If needed, open new file and print header
-                {
-                    filename = P.fileout;
-                    if (fout.is_open())
-                        fout.close();
-                    fout.open(P.fileout);
+                int e = types[events.Draw(R)];
+                long long i = R.Bounded(P.n_hosts);
+                pending.push_back({ e, i, (e & 0xF0000) == Transfer ? (long long)R.Bounded(P.n_hosts) : -1 });
+            }
 
-                    sout << "run\ttau\tt";
-                    for (int e = 0; e < P.n_strains / 2; ++e)
-                        sout << "\t" << string(1 + e / 26, char('A' + e % 26)) << "s\t" << string(1 + e / 26, char('A' + e % 26)) << "r";
-                    sout << "\tmult\tcarr0\tcarr1\tcarr2\tcarr3\tcarr4\tcarr5\tcarr6\tcarr7\tcarr8plus\n";
+            // Assign each event a level (strict), or a batch (relaxed): 1 if both its hosts are free, claiming them, or
+            // 2 (deferred) if not
+            int n_levels = 0;
+            levels.resize(pending.size());
+            for (size_t q = 0; q < pending.size(); ++q)
+            {
+                long long i = pending[q].i, ii = pending[q].ii < 0 ? i : pending[q].ii;
+                int level_i = host_step[i] == g ? host_level[i] : 0, level_ii = host_step[ii] == g ? host_level[ii] : 0;
+                int level = P.par_events == "strict" ? max(level_i, level_ii) + 1 : (level_i || level_ii ? 2 : 1);
+                if (level == 1 || P.par_events == "strict")
+                {
+                    host_step[i] = host_step[ii] = g;
+                    host_level[i] = host_level[ii] = level;
                 }
+                levels[q] = level;
+                n_levels = max(n_levels, level);
+            }
+
+            // Sort events by level, keeping urn order within each level
+            level_start.assign(n_levels + 2, 0);
+            for (auto h : levels)
+                ++level_start[h + 1];
+            for (int h = 1; h <= n_levels; ++h)
+                level_start[h + 1] += level_start[h];
+            order.resize(pending.size());
+            for (size_t q = 0; q < pending.size(); ++q)
+                order[level_start[levels[q]]++] = q;
+            for (int h = n_levels + 1; h > 0; --h)
+                level_start[h] = level_start[h - 1];
 
-                sout << run << "\t" << P.tau << "\t" << g * P.t_step;
-                for (auto ll : l)
-                    sout << "\t" << ll;
+            phase.Switch(Instruments::Events);
+            drawn.assign(pool.Size(), 0);
+            auto execute_pending = [&](int t, long long q)
+            {
+                CounterStream rng(key, g, q, theta_cutoffs.data());
+                execute(pending[q].e, time, pending[q].i, pending[q].ii, rng);
+                drawn[t] += rng.Draws();
+            };
+            for (int h = 1; h <= n_levels; ++h)
+            {
+                if (P.par_events == "relaxed" && h == 2)    // Deferred events run serially
+                    for (long long r = level_start[h]; r < level_start[h + 1]; ++r)
+                        execute_pending(0, order[r]);
+                else
+                    pool.For(level_start[h], level_start[h + 1], [&](int t, long long r0, long long r1)
+                    {
+                        for (long long r = r0; r < r1; ++r)
+                            execute_pending(t, order[r]);
+                    });
+            }
+            if (C.stats)
+                for (auto n : drawn)
+                    C.stats->Drawn(n);
+        }
 
-                vector<int> strain_count(9, 0), serotype_count(9, 0);
-                double mult = 0, STmult = 0, carriers = 0;
-                for (int i = 0; i < P.n_strains * P.n_hosts; i += P.n_strains)
+        // 4. Report, now or with the next growth pass
+        if (g % P.report == 0)
+        {
+            if (lazy)
+                report(time, l);
+            else
+                l_report = l, t_report = time;
+        }
+    }
+    if (t_report >= 0)
+        report(t_report, l_report);
+    C.sink.Sync();
+}
+
+template <typename Hosts>
+void Simulate(int run, Context& C)
+{
+    if (C.P.k != 1)
+        C.P.immunity ? Simulate<Hosts, true, true>(run, C) : Simulate<Hosts, true, false>(run, C);
+    else
+        C.P.immunity ? Simulate<Hosts, false, true>(run, C) : Simulate<Hosts, false, false>(run, C);
+}
+
+template <typename T>
+void SimulateDense(int run, Context& C)
+{
+    switch (C.P.n_strains)
+    {
+        case 2:  Simulate<DenseHosts<2, T>>(run, C);  break;
+        case 4:  Simulate<DenseHosts<4, T>>(run, C);  break;
+        case 10: Simulate<DenseHosts<10, T>>(run, C); break;
+        case 20: Simulate<DenseHosts<20, T>>(run, C); break;
+        case 60: Simulate<DenseHosts<60, T>>(run, C); break;
+        default: Simulate<DenseHosts<0, T>>(run, C);  break;
+    }
+}
+
+// Dispatch to an engine for the host store and precision in the current parameter set, specialized for the number of
+// strains where possible, or falling back on the generic engine
+void Simulate(int run, Context& C)
+{
+    const Parameters& P = C.P;
+    if (P.engine != "step" && P.engine != "lazy" && P.engine != "exact")
+        throw runtime_error("Unrecognized engine " + P.engine);
+    if (P.par_events != "off" && P.par_events != "strict" && P.par_events != "relaxed")
+        throw runtime_error("Unrecognized par_events " + P.par_events);
+    if (P.par_events != "off" && P.engine != "step")
+        throw runtime_error("Parallel event execution (par_events) needs engine step");
+    if (P.format != "text" && P.format != "binary")
+        throw runtime_error("Unrecognized format " + P.format);
+    if (P.map_warm && P.mapfile.empty())
+        throw runtime_error("A warm start (map_warm) needs a state file (mapfile)");
+    if ((!P.checkpoint.empty() || C.resume) && P.engine != "step")
+        throw runtime_error("Checkpoints need engine step");
+    if (P.adaptive && (P.adapt_tol <= 0 || P.adapt_events <= 0 || P.t_step_max < P.t_step))
+        throw runtime_error("Adaptive stepping needs adapt_tol > 0, adapt_events > 0 and t_step_max >= t_step");
+    if (P.stats != "off" && P.stats != "on" && P.stats != "perf")
+        throw runtime_error("Unrecognized stats " + P.stats);
+    if (P.steady_tol > 0 && (P.steady_batches < 3 || P.steady_burnin < 0 || P.steady_burnin >= 1 || P.steady_z <= 0))
+        throw runtime_error("Steady-state detection needs steady_batches >= 3, 0 <= steady_burnin < 1 and steady_z > 0");
+
+    if (P.store == "sparse")
+        return Simulate<SparseHosts>(run, C);
+    else if (P.store != "dense")
+        throw runtime_error("Unrecognized store " + P.store);
+
+    if (P.precision == "double")
+        return SimulateDense<double>(run, C);
+    else if (P.precision == "float")
+        return SimulateDense<float>(run, C);
+    else if (P.precision == "fixed")
+        return SimulateDense<Fixed>(run, C);
+    throw runtime_error("Unrecognized precision " + P.precision);
+}
+
+// Run parameter set P as run number run, with random numbers from R and within-step work split over pool; screen, sink,
+// replicate, rows, resume, stats and steady are as in Context
+void Run(int run, Parameters& P, Randomizer& R, ThreadPool& pool, ostream& screen, ReportSink& sink,
+    int replicate = -1, vector<vector<double>>* rows = 0, istream* resume = 0, Instruments* stats = 0, SteadyState* steady = 0)
+{
+    Check(P.w,     P.n_strains,     "w");
+    Check(P.beta,  P.n_strains,     "beta");
+    Check(P.theta, P.n_strains,     "theta");
+    Check(P.u,     P.n_strains / 2, "u");
+
+    Kernels K = SelectKernels(P.simd, P.n_strains);
+    pool.Resize(P.threads);
+
+    P.Write(screen);    // Print parameters
+    Context C = { P, R, K, pool, screen, sink, replicate, rows, resume, stats, steady };
+    Instruments::Scope scope(stats, Instruments::Other);
+    uint64_t draws = R.Draws();
+    Simulate(run, C);
+    if (stats)
+        stats->Drawn(R.Draws() - draws);
+    if (steady && steady->Steady())
+    {
+        vector<string> strains = Columns(P.n_strains);
+        screen << "Steady at t = " << steady->Time() << ":";
+        for (int s = 0; s < P.n_strains; ++s)
+            screen << " " << strains[s] << " " << steady->Estimate()[s] << " +/- " << steady->HalfWidth()[s];
+        screen << "\n";
+    }
+}
+
+// A log of one row per run, in a file named for the run's parameter set, starting a new file when the name changes, or
+// when resuming from a checkpoint, continuing the file as it was then
+struct RunLog
+{
+    ofstream out;
+    string filename = "\n";
+
+    // Make name the current file, returning true if it is new and needs a header
+    bool Open(const string& name)
+    {
+        if (name == filename)
+            return false;
+        filename = name;
+        if (out.is_open())
+            out.close();
+        out.open(filename);
+        return true;
+    }
+
+    // Continue file name cut back to length, if anything had been written to it (length > 0; see LogLength)
+    void Resume(const string& name, int64_t length)
+    {
+        if (length <= 0)
+            return;
+        filesystem::resize_file(name, length);
+        out.open(name, ios::app);
+        filename = name;
+    }
+};
+
+// Instrumentation of runs: one row per run, in the stats file of its parameter set (see StatsFile), and totals over all
+// runs for a summary at the end
+struct StatsLog : RunLog
+{
+    Instruments total;
+    int runs = 0;
+
+    // Instruments for a run of parameter set P, or none if P.stats is off
+    static unique_ptr<Instruments> For(const Parameters& P)
+    {
+        return unique_ptr<Instruments>(P.stats == "off" ? 0 : new Instruments(P.stats == "perf"));
+    }
+
+    void Write(const Parameters& P, int run, int replicate, const Instruments& I)
+    {
+        if (Open(StatsFile(P)))
+            Instruments::WriteHeader(out, P.stats == "perf");
+        I.Write(out, run, replicate, P.tau);
+        out.flush();
+        total.Add(I);
+        ++runs;
+    }
+
+    void Summary(ostream& screen)
+    {
+        if (runs > 0)
+            total.Summary(screen, runs);
+    }
+};
+
+// Steady states of runs: one row per run, in the steady file of its parameter set (see SteadyFile)
+struct SteadyLog : RunLog
+{
+    // Detector for a run of parameter set P, or none if P.steady_tol is 0
+    static unique_ptr<SteadyState> For(const Parameters& P)
+    {
+        return unique_ptr<SteadyState>(P.steady_tol <= 0 ? 0 :
+            new SteadyState(P.steady_tol, P.steady_batches, P.steady_burnin, P.steady_z, P.steady_t_min));
+    }
+
+    void Write(const Parameters& P, int run, int replicate, const SteadyState& S)
+    {
+        if (Open(SteadyFile(P)))
+        {
+            vector<string> columns = Columns(P.n_strains);
+            SteadyState::WriteHeader(out, vector<string>(columns.begin(), columns.begin() + P.n_strains));
+        }
+        S.Write(out, run, replicate, P.tau);
+        out.flush();
+    }
+};
+
+// Run all parameter sets (sweeps) in P, each P.replicates times, as jobs shared among P.sweep_threads worker threads.
+// Each job runs with its own copy of the parameters and its own random number stream, seeded from P.seed, the sweep
+// number and the replicate number, so results do not depend on the number of workers. Output is buffered per job and
+// written in job order as jobs finish; as when sweeps run one after another, a job starts a new output file when its
+// fileout differs from the previous job's, and appends otherwise. With replicates > 1, rows are labelled by replicate,
+// and after a sweep's last replicate, the ensemble mean, variance and quantiles of each column at each report time,
+// accumulated in replicate order, are written to the sweep's ensemble file (see EnsembleFile).
+void RunSweeps()
+{
+    struct Job { int sweep, replicate; ostringstream screen, out; vector<vector<double>> rows; unique_ptr<Instruments> stats; unique_ptr<SteadyState> steady; bool done = false; exception_ptr error; };
+    vector<Parameters> sweeps;
+    for (; P.Good(); P.NextSweep())
+        sweeps.push_back(P);
+    vector<Job> jobs;
+    for (int s = 0; s < (int)sweeps.size(); ++s)
+    {
+        if (sweeps[s].replicates < 1)
+            throw runtime_error("Parameter replicates must be at least 1");
+        for (int r = 0; r < sweeps[s].replicates; ++r)
+        {
+            jobs.emplace_back();
+            jobs.back().sweep = s;
+            jobs.back().replicate = r;
+        }
+    }
+    const int n = jobs.size();
+
+    atomic<int> next(0);
+    atomic<bool> failed(false);
+    mutex m;
+    int written = 0;
+    string filename = "\n", ensemble_filename = "\n";
+    ofstream fout, fens;
+    unique_ptr<Ensemble> ensemble;
+    StatsLog log;
+    SteadyLog steady_log;
+
+    auto work = [&]()
+    {
+        Randomizer R;
+        ThreadPool pool;
+        for (int j; !failed && (j = next++) < n; )
+        {
+            Job& job = jobs[j];
+            Parameters& Q = sweeps[job.sweep];
+            bool replicated = Q.replicates > 1;
+            try
+            {
+                R.SetEngine(Q.rng);
+                R.Seed({ uint32_t(Q.seed), uint32_t(job.sweep), uint32_t(job.replicate) });
+                StreamWriter sink(job.screen, job.out, j == 0 || Q.fileout != sweeps[jobs[j - 1].sweep].fileout);
+                job.stats = StatsLog::For(Q);
+                job.steady = SteadyLog::For(Q);
+                Run(job.sweep, Q, R, pool, job.screen, sink, replicated ? job.replicate : -1, replicated ? &job.rows : 0, 0,
+                    job.stats.get(), job.steady.get());
+            }
+            catch (...)
+            {
+                job.error = current_exception();
+                failed = true;
+            }
+
+            lock_guard<mutex> lock(m);  // Write out finished jobs, in order, up to the first error
+            for (job.done = true; written < n && jobs[written].done && !jobs[written].error; ++written)
+            {
+                Job& o = jobs[written];
+                Parameters& Qo = sweeps[o.sweep];
+                if (Qo.fileout != filename)
                 {
-                    int m = count_if(X.begin() + i, X.begin() + i + (P.first_sero ? 2 : P.n_strains), [](double x) { return x > 0; });
-                    if (m > 0) { ++carriers; mult += m; }
-                    ++strain_count[min(8, m)];
+                    if (fout.is_open())
+                        fout.close(), FinishTrajectory(filename);
+                    filename = Qo.fileout;
+                    fout.open(filename);
                 }
-                sout << "\t" << mult / carriers;
-                for (auto s : strain_count)
-                    sout << "\t" << s;
+                cout << o.screen.str() << flush;
+                fout << o.out.str();
+                o.screen.str(string());
+                o.out.str(string());
+                if (o.stats)
+                    log.Write(Qo, o.sweep, o.replicate, *o.stats), o.stats.reset();
+                if (o.steady)
+                    steady_log.Write(Qo, o.sweep, o.replicate, *o.steady), o.steady.reset();
 
-                cout << sout.str() << "\n";
-                fout << sout.str() << "\n";
-                sout.str(string());
+                if (Qo.replicates > 1)
+                {
+                    if (o.replicate == 0)
+                        ensemble.reset(new Ensemble(Columns(Qo.n_strains), Qo.quantiles));
+                    ensemble->Add(o.rows);
+                    vector<vector<double>>().swap(o.rows);
+                    if (o.replicate == Qo.replicates - 1)
+                    {
+                        if (EnsembleFile(Qo) != ensemble_filename)
+                        {
+                            ensemble_filename = EnsembleFile(Qo);
+                            if (fens.is_open())
+                                fens.close();
+                            fens.open(ensemble_filename);
+                            ensemble->WriteHeader(fens);
+                        }
+                        ensemble->Write(fens, o.sweep, Qo.tau);
+                        fens.flush();
+                        ensemble.reset();
+                    }
+                }
             }
         }
+    };
+
+    vector<thread> workers;
+    for (int t = 1; t < min(P.sweep_threads, n); ++t)
+        workers.emplace_back(work);
+    work();
+    for (auto& w : workers)
+        w.join();
+    if (fout.is_open())
+        fout.close(), FinishTrajectory(filename);
+
+    if (written < n && jobs[written].error)
+    {
+        cout << jobs[written].screen.str();
+        rethrow_exception(jobs[written].error);
     }
+    log.Summary(cout);
+}
+
+int main(int argc, char* argv[])
+{
+    P.Read(argc, argv);
+    bool replicated = false, mapped = false;
+    for (Parameters Q = P; Q.Good(); Q.NextSweep())
+    {
+        replicated = replicated || Q.replicates != 1;
+        mapped = mapped || !Q.mapfile.empty();
+    }
+    if (P.sweep_threads > 1 || replicated)
+    {
+        if (!P.checkpoint.empty() || !P.resume.empty())
+            throw runtime_error("Checkpoints need sweep_threads 1 and replicates 1");
+        if (mapped)     // Jobs would share one carriage matrix
+            throw runtime_error("A state file (mapfile) needs sweep_threads 1 and replicates 1");
+        RunSweeps();
+        return 0;
+    }
+
+    int run = 0, seed = 0; string filename = "\n";
+    ThreadPool pool;
+    ifstream snapshot;
+    FileWriter writer(cout, P.async_output);
+    StatsLog log;
+    SteadyLog steady_log;
+
+    if (!P.resume.empty())  // Resume from a checkpoint: skip to its run and cut the output file and logs back to where they were
+    {
+        char magic[sizeof(CheckpointMagic)];
+        int64_t length = 0, stats_length = -1, steady_length = -1;
+        string signature;
+        snapshot.open(P.resume, ios::binary);
+        snapshot.read(magic, sizeof(magic));
+        Get(snapshot, run); Get(snapshot, length); Get(snapshot, signature); Get(snapshot, stats_length); Get(snapshot, steady_length);
+        if (!snapshot || memcmp(magic, CheckpointMagic, sizeof(magic)) != 0)
+            throw runtime_error("Could not read checkpoint " + P.resume);
+        for (int r = 0; r < run && P.Good(); ++r)
+            P.NextSweep();
+        if (!P.Good() || signature != Signature(P))
+            throw runtime_error("Parameters do not match those of checkpoint " + P.resume);
+
+        writer.Open(P.fileout, length);
+        filename = P.fileout;
+        log.Resume(StatsFile(P), stats_length);
+        steady_log.Resume(SteadyFile(P), steady_length);
+        seed = P.seed;
+    }
+    if (!P.checkpoint.empty())
+    {
+        signal(SIGTERM, OnSignal);
+        signal(SIGUSR1, OnSignal);
+    }
+
+    // Iterate over parameter sets
+    try
+    {
+        for (; P.Good(); P.NextSweep(), ++run)
+        {
+            if (filename != P.fileout)  // If needed, finish the last file and open a new one
+                writer.Open(filename = P.fileout);
+
+            R.SetEngine(P.rng);
+            if (P.seed != seed)     // Restart the stream on a change of seed, from the built-in seed for seed 0
+                R.Seed(P.seed ? vector<uint32_t>{ uint32_t(P.seed) } : Randomizer::BuiltinSeed()), seed = P.seed;
+            auto stats = StatsLog::For(P);
+            auto steady = SteadyLog::For(P);
+            Run(run, P, R, pool, cout, writer, -1, 0, snapshot.is_open() ? &snapshot : 0, stats.get(), steady.get());
+            snapshot.close();
+            if (stats)
+                log.Write(P, run, 0, *stats);
+            if (steady)
+                steady_log.Write(P, run, 0, *steady);
+        }
+    }
+    catch (Stop&)
+    {
+        cout << "Stopped on SIGTERM after checkpoint\n";
+    }
+    writer.Close();
+    log.Summary(cout);
 
     return 0;
-}
\ No newline at end of file
+}